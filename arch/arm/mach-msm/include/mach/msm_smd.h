@@ -18,6 +18,7 @@
 #ifndef __ASM_ARCH_MSM_SMD_H
 #define __ASM_ARCH_MSM_SMD_H
 
+#include <linux/uio.h>
 #include "../../smd_private.h"    //SW2-5-1-MP-HostOemInfo-00+
 
 typedef struct smd_channel smd_channel_t;
@@ -43,6 +44,28 @@ int smd_read_from_cb(smd_channel_t *ch, void *data, int len);
 */
 int smd_write(smd_channel_t *ch, const void *data, int len);
 
+/* Gather write of nr segments as one packet (or one run of stream
+** data).  Never does a partial write: returns the total length or an
+** error, -ENOMEM if it does not fit in the FIFO.
+** With SMD_WRITE_MORE the other processor is not signalled; the caller
+** must end the batch with a write without the flag or smd_write_kick().
+*/
+#define SMD_WRITE_MORE 1
+
+int smd_writev(smd_channel_t *ch, const struct kvec *iov, int nr,
+	       unsigned flags);
+void smd_write_kick(smd_channel_t *ch);
+
+/* Interrupt coalescing windows in microseconds, 0 disables.  The first
+** event after a quiet period is always delivered at once; later ones
+** are held until the window since the previous one has passed, or the
+** FIFO is more than half full.  tx covers interrupts raised to the
+** remote processor, rx the SMD_EVENT_DATA notifications to the client.
+** Channels start with the msm_smd tx_coalesce_us/rx_coalesce_us
+** module parameters.
+*/
+void smd_set_coalesce(smd_channel_t *ch, unsigned tx_us, unsigned rx_us);
+
 int smd_write_avail(smd_channel_t *ch);
 int smd_read_avail(smd_channel_t *ch);
 
@@ -84,6 +107,11 @@ enum {
 };
 #endif
 
+/* Software packet channel that reads back whatever is written to it,
+** opened with smd_named_open_on_edge() on SMD_LOOPBACK_TYPE.
+*/
+#define SMD_LOOPBACK_PKT_NAME "local_loopback_pkt"
+
 int smd_named_open_on_edge(const char *name, uint32_t edge, smd_channel_t **_ch,
 			   void *priv, void (*notify)(void *, unsigned));
 
@@ -29,6 +29,7 @@
 #include <linux/io.h>
 #include <linux/termios.h>
 #include <linux/ctype.h>
+#include <linux/hrtimer.h>
 #include <mach/msm_smd.h>
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
@@ -98,6 +99,14 @@ static int msm_smd_debug_mask;
 module_param_named(debug_mask, msm_smd_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* default interrupt coalescing windows applied at open, 0 disables */
+static int msm_smd_tx_coalesce_us;
+module_param_named(tx_coalesce_us, msm_smd_tx_coalesce_us,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int msm_smd_rx_coalesce_us;
+module_param_named(rx_coalesce_us, msm_smd_rx_coalesce_us,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
 #if defined(CONFIG_MSM_SMD_DEBUG)
 #define SMD_DBG(x...) do {				\
 		if (msm_smd_debug_mask & MSM_SMD_DEBUG) \
@@ -148,6 +157,7 @@ static unsigned last_heap_free = 0xffffffff;
 #endif
 
 #define SMD_LOOPBACK_CID 100
+#define SMD_LOOPBACK_PKT_CID 101
 
 static LIST_HEAD(smd_ch_list_loopback);
 
@@ -289,6 +299,20 @@ struct smd_channel {
 	char name[20];
 	struct platform_device pdev;
 	unsigned type;
+
+	/* interrupt coalescing, see smd_signal_other() and smd_notify_data()
+	 * signal_* is protected by coalesce_lock, notify_* by smd_lock
+	 */
+	spinlock_t coalesce_lock;
+	ktime_t tx_window;
+	ktime_t rx_window;
+	ktime_t last_signal;
+	ktime_t last_notify;
+	int signal_pending;
+	int notify_pending;
+	struct hrtimer signal_timer;
+	struct hrtimer notify_timer;
+	struct smd_ch_stats stats;
 };
 
 static LIST_HEAD(smd_ch_closed_list);
@@ -421,6 +445,7 @@ static int ch_read(struct smd_channel *ch, void *_data, int len)
 		ch_read_done(ch, n);
 	}
 
+	ch->stats.rx_bytes += orig_len - len;
 	return orig_len - len;
 }
 
@@ -492,6 +517,133 @@ static void ch_set_state(struct smd_channel *ch, unsigned n)
 	ch->notify_other_cpu();
 }
 
+static enum hrtimer_restart smd_signal_timer_fn(struct hrtimer *timer)
+{
+	struct smd_channel *ch =
+		container_of(timer, struct smd_channel, signal_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ch->coalesce_lock, flags);
+	if (ch->signal_pending) {
+		ch->signal_pending = 0;
+		ch->last_signal = ktime_get();
+		ch->stats.signals++;
+		ch->notify_other_cpu();
+	}
+	spin_unlock_irqrestore(&ch->coalesce_lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Tell the remote processor that the FIFO indices moved.  With a
+ * coalescing window, the first signal after a quiet period goes out at
+ * once; later ones are held until the window since the last signal
+ * expires, unless the send FIFO is more than half full.
+ */
+static void smd_signal_other(struct smd_channel *ch)
+{
+	unsigned long flags;
+	ktime_t now;
+	unsigned used;
+
+	if (ch->tx_window.tv64 == 0) {
+		ch->stats.signals++;
+		ch->notify_other_cpu();
+		return;
+	}
+
+	spin_lock_irqsave(&ch->coalesce_lock, flags);
+	now = ktime_get();
+	used = (ch->send->head - ch->send->tail) & ch->fifo_mask;
+
+	if (used <= ch->fifo_size / 2) {
+		if (ch->signal_pending) {
+			ch->stats.signals_coalesced++;
+			goto out;
+		}
+		if (ktime_to_ns(ktime_sub(now, ch->last_signal)) <
+		    ktime_to_ns(ch->tx_window)) {
+			ch->signal_pending = 1;
+			ch->stats.signals_coalesced++;
+			hrtimer_start(&ch->signal_timer,
+				      ktime_add(ch->last_signal, ch->tx_window),
+				      HRTIMER_MODE_ABS);
+			goto out;
+		}
+	}
+
+	/* a running timer callback sees signal_pending clear and backs off */
+	if (ch->signal_pending) {
+		hrtimer_try_to_cancel(&ch->signal_timer);
+		ch->signal_pending = 0;
+	}
+	ch->last_signal = now;
+	ch->stats.signals++;
+	ch->notify_other_cpu();
+out:
+	spin_unlock_irqrestore(&ch->coalesce_lock, flags);
+}
+
+static enum hrtimer_restart smd_notify_timer_fn(struct hrtimer *timer)
+{
+	struct smd_channel *ch =
+		container_of(timer, struct smd_channel, notify_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&smd_lock, flags);
+	if (ch->notify_pending) {
+		ch->notify_pending = 0;
+		if (ch_is_open(ch)) {
+			ch->last_notify = ktime_get();
+			ch->stats.wakeups++;
+			ch->update_state(ch);
+			ch->notify(ch->priv, SMD_EVENT_DATA);
+		}
+	}
+	spin_unlock_irqrestore(&smd_lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Deliver a data event to the client, rate limited to one per receive
+ * window in the same way as smd_signal_other().  Called with smd_lock
+ * held after the channel state has been updated.
+ */
+static void smd_notify_data(struct smd_channel *ch)
+{
+	ktime_t now;
+
+	ch->stats.irqs++;
+	if (ch->rx_window.tv64 == 0) {
+		ch->stats.wakeups++;
+		ch->notify(ch->priv, SMD_EVENT_DATA);
+		return;
+	}
+
+	if (ch->notify_pending) {
+		ch->stats.wakeups_coalesced++;
+		return;
+	}
+
+	now = ktime_get();
+	if (ktime_to_ns(ktime_sub(now, ch->last_notify)) <
+	    ktime_to_ns(ch->rx_window) &&
+	    smd_stream_read_avail(ch) <= ch->fifo_size / 2) {
+		ch->notify_pending = 1;
+		ch->stats.wakeups_coalesced++;
+		hrtimer_start(&ch->notify_timer,
+			      ktime_add(ch->last_notify, ch->rx_window),
+			      HRTIMER_MODE_ABS);
+		return;
+	}
+
+	ch->last_notify = now;
+	ch->stats.wakeups++;
+	ch->notify(ch->priv, SMD_EVENT_DATA);
+}
+
 static void do_smd_probe(void)
 {
 	struct smem_shared *shared = (void *) MSM_SHARED_RAM_BASE;
@@ -569,7 +721,7 @@ static void handle_smd_irq(struct list_head *list, void (*notify)(void))
 			smd_state_change(ch, ch->last_state, tmp);
 		if (ch_flags) {
 			ch->update_state(ch);
-			ch->notify(ch->priv, SMD_EVENT_DATA);
+			smd_notify_data(ch);
 		}
 	}
 	if (do_notify)
@@ -671,19 +823,14 @@ static int smd_is_packet(struct smd_alloc_elm *alloc_elm)
 		return 0;
 }
 
-static int smd_stream_write(smd_channel_t *ch, const void *_data, int len)
+/* copy into the FIFO without signalling the other processor */
+static int smd_stream_copy(smd_channel_t *ch, const void *_data, int len)
 {
 	void *ptr;
 	const unsigned char *buf = _data;
 	unsigned xfer;
 	int orig_len = len;
 
-	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
-	if (len < 0)
-		return -EINVAL;
-	else if (len == 0)
-		return 0;
-
 	while ((xfer = ch_write_buffer(ch, &ptr)) != 0) {
 		if (!ch_is_open(ch))
 			break;
@@ -697,12 +844,27 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len)
 			break;
 	}
 
-	if (orig_len - len)
-		ch->notify_other_cpu();
-
+	ch->stats.tx_bytes += orig_len - len;
 	return orig_len - len;
 }
 
+static int smd_stream_write(smd_channel_t *ch, const void *_data, int len)
+{
+	int ret;
+
+	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
+	if (len < 0)
+		return -EINVAL;
+	else if (len == 0)
+		return 0;
+
+	ret = smd_stream_copy(ch, _data, len);
+	if (ret)
+		smd_signal_other(ch);
+
+	return ret;
+}
+
 static int smd_packet_write(smd_channel_t *ch, const void *_data, int len)
 {
 	int ret;
@@ -720,17 +882,17 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len)
 	hdr[0] = len;
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
-
-	ret = smd_stream_write(ch, hdr, sizeof(hdr));
-	if (ret < 0 || ret != sizeof(hdr)) {
+	/* header and payload go out behind a single interrupt */
+	ret = smd_stream_copy(ch, hdr, sizeof(hdr));
+	if (ret != sizeof(hdr)) {
 		SMD_DBG("%s failed to write pkt header: "
 			"%d returned\n", __func__, ret);
 		return -1;
 	}
 
-
-	ret = smd_stream_write(ch, _data, len);
-	if (ret < 0 || ret != len) {
+	ret = smd_stream_copy(ch, _data, len);
+	smd_signal_other(ch);
+	if (ret != len) {
 		SMD_DBG("%s failed to write pkt data: "
 			"%d returned\n", __func__, ret);
 		return ret;
@@ -748,7 +910,7 @@ static int smd_stream_read(smd_channel_t *ch, void *data, int len)
 
 	r = ch_read(ch, data, len);
 	if (r > 0)
-		ch->notify_other_cpu();
+		smd_signal_other(ch);
 
 	return r;
 }
@@ -767,7 +929,7 @@ static int smd_packet_read(smd_channel_t *ch, void *data, int len)
 
 	r = ch_read(ch, data, len);
 	if (r > 0)
-		ch->notify_other_cpu();
+		smd_signal_other(ch);
 
 	spin_lock_irqsave(&smd_lock, flags);
 	ch->current_packet -= r;
@@ -789,7 +951,7 @@ static int smd_packet_read_from_cb(smd_channel_t *ch, void *data, int len)
 
 	r = ch_read(ch, data, len);
 	if (r > 0)
-		ch->notify_other_cpu();
+		smd_signal_other(ch);
 
 	ch->current_packet -= r;
 	update_packet_state(ch);
@@ -914,6 +1076,77 @@ static inline void notify_loopback_smd(void)
 	spin_unlock_irqrestore(&smd_lock, flags);
 }
 
+/*
+ * The packet loopback channel signals the reader from a tasklet rather
+ * than from the writer's context, as an interrupt from the other
+ * processor would, so that notify handlers may read from the channel.
+ */
+static void smd_loopback_pkt_handler(unsigned long arg)
+{
+	struct smd_channel *ch = (struct smd_channel *)arg;
+	unsigned long flags;
+
+	spin_lock_irqsave(&smd_lock, flags);
+	if (ch_is_open(ch)) {
+		ch->update_state(ch);
+		smd_notify_data(ch);
+	}
+	spin_unlock_irqrestore(&smd_lock, flags);
+}
+
+static DECLARE_TASKLET(smd_loopback_pkt_tasklet, smd_loopback_pkt_handler, 0);
+
+static void notify_loopback_pkt_smd(void)
+{
+	tasklet_schedule(&smd_loopback_pkt_tasklet);
+}
+
+static int smd_alloc_loopback_pkt_channel(void)
+{
+	static struct smd_half_channel smd_loopback_pkt_ctl;
+	static char smd_loopback_pkt_data[SMD_BUF_SIZE];
+	struct smd_channel *ch;
+
+	ch = kzalloc(sizeof(struct smd_channel), GFP_KERNEL);
+	if (ch == 0) {
+		pr_err("%s: out of memory\n", __func__);
+		return -1;
+	}
+	ch->n = SMD_LOOPBACK_PKT_CID;
+
+	ch->send = &smd_loopback_pkt_ctl;
+	ch->recv = &smd_loopback_pkt_ctl;
+	ch->send_data = smd_loopback_pkt_data;
+	ch->recv_data = smd_loopback_pkt_data;
+	ch->fifo_size = SMD_BUF_SIZE;
+
+	ch->fifo_mask = ch->fifo_size - 1;
+	ch->type = SMD_LOOPBACK_TYPE;
+	ch->notify_other_cpu = notify_loopback_pkt_smd;
+	smd_loopback_pkt_tasklet.data = (unsigned long)ch;
+
+	ch->read = smd_packet_read;
+	ch->write = smd_packet_write;
+	ch->read_avail = smd_packet_read_avail;
+	ch->write_avail = smd_packet_write_avail;
+	ch->update_state = update_packet_state;
+	ch->read_from_cb = smd_packet_read_from_cb;
+
+	strlcpy(ch->name, SMD_LOOPBACK_PKT_NAME, sizeof(ch->name));
+
+	ch->pdev.name = ch->name;
+	ch->pdev.id = ch->type;
+
+	SMD_INFO("%s: '%s' cid=%d\n", __func__, ch->name, ch->n);
+
+	mutex_lock(&smd_creation_mutex);
+	list_add(&ch->ch_list, &smd_ch_closed_list);
+	mutex_unlock(&smd_creation_mutex);
+
+	platform_device_register(&ch->pdev);
+	return 0;
+}
+
 static int smd_alloc_loopback_channel(void)
 {
 	static struct smd_half_channel smd_loopback_ctl;
@@ -1008,6 +1241,17 @@ int smd_named_open_on_edge(const char *name, uint32_t edge,
 	ch->last_state = SMD_SS_CLOSED;
 	ch->priv = priv;
 
+	spin_lock_init(&ch->coalesce_lock);
+	hrtimer_init(&ch->signal_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	ch->signal_timer.function = smd_signal_timer_fn;
+	hrtimer_init(&ch->notify_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	ch->notify_timer.function = smd_notify_timer_fn;
+	ch->signal_pending = 0;
+	ch->notify_pending = 0;
+	ch->last_signal = ktime_set(0, 0);
+	ch->last_notify = ktime_set(0, 0);
+	smd_set_coalesce(ch, msm_smd_tx_coalesce_us, msm_smd_rx_coalesce_us);
+
 	if (edge == SMD_LOOPBACK_TYPE) {
 		ch->last_state = SMD_SS_OPENED;
 		ch->send->state = SMD_SS_OPENED;
@@ -1062,7 +1306,7 @@ int smd_close(smd_channel_t *ch)
 	spin_lock_irqsave(&smd_lock, flags);
 	ch->notify = do_nothing_notify;
 	list_del(&ch->ch_list);
-	if (ch->n == SMD_LOOPBACK_CID) {
+	if (ch->n == SMD_LOOPBACK_CID || ch->n == SMD_LOOPBACK_PKT_CID) {
 		ch->send->fDSR = 0;
 		ch->send->fCTS = 0;
 		ch->send->fCD = 0;
@@ -1071,6 +1315,10 @@ int smd_close(smd_channel_t *ch)
 		ch_set_state(ch, SMD_SS_CLOSED);
 	spin_unlock_irqrestore(&smd_lock, flags);
 
+	/* closing signalled the remote; drop anything held back */
+	hrtimer_cancel(&ch->signal_timer);
+	hrtimer_cancel(&ch->notify_timer);
+
 	mutex_lock(&smd_creation_mutex);
 	list_add(&ch->ch_list, &smd_ch_closed_list);
 	mutex_unlock(&smd_creation_mutex);
@@ -1097,6 +1345,98 @@ int smd_write(smd_channel_t *ch, const void *data, int len)
 }
 EXPORT_SYMBOL(smd_write);
 
+int smd_writev(smd_channel_t *ch, const struct kvec *iov, int nr,
+	       unsigned flags)
+{
+	unsigned hdr[5];
+	int is_pkt = (ch->update_state == update_packet_state);
+	int len = 0;
+	int i, ret;
+
+	for (i = 0; i < nr; i++)
+		len += iov[i].iov_len;
+
+	SMD_DBG("smd_writev() %d in %d segments -> ch%d\n", len, nr, ch->n);
+	if (len == 0)
+		return 0;
+
+	if (smd_stream_write_avail(ch) <
+	    len + (is_pkt ? SMD_HEADER_SIZE : 0))
+		return -ENOMEM;
+
+	if (is_pkt) {
+		hdr[0] = len;
+		hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
+		if (smd_stream_copy(ch, hdr, sizeof(hdr)) != sizeof(hdr))
+			return -EIO;
+	}
+
+	for (i = 0; i < nr; i++) {
+		ret = smd_stream_copy(ch, iov[i].iov_base, iov[i].iov_len);
+		if (ret != iov[i].iov_len)
+			break;
+	}
+
+	if (!(flags & SMD_WRITE_MORE) || i < nr)
+		smd_signal_other(ch);
+
+	return i < nr ? -EIO : len;
+}
+EXPORT_SYMBOL(smd_writev);
+
+void smd_write_kick(smd_channel_t *ch)
+{
+	smd_signal_other(ch);
+}
+EXPORT_SYMBOL(smd_write_kick);
+
+void smd_set_coalesce(smd_channel_t *ch, unsigned tx_us, unsigned rx_us)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&smd_lock, flags);
+	spin_lock(&ch->coalesce_lock);
+	ch->tx_window = ns_to_ktime((u64)tx_us * NSEC_PER_USEC);
+	ch->rx_window = ns_to_ktime((u64)rx_us * NSEC_PER_USEC);
+	ch->stats.tx_coalesce_us = tx_us;
+	ch->stats.rx_coalesce_us = rx_us;
+	spin_unlock(&ch->coalesce_lock);
+	spin_unlock_irqrestore(&smd_lock, flags);
+}
+EXPORT_SYMBOL(smd_set_coalesce);
+
+static int smd_get_list_stats(struct list_head *list,
+			      struct smd_ch_stats *stats, int max)
+{
+	struct smd_channel *ch;
+	int n = 0;
+
+	list_for_each_entry(ch, list, ch_list) {
+		if (n == max)
+			break;
+		stats[n] = ch->stats;
+		strlcpy(stats[n].name, ch->name, sizeof(stats[n].name));
+		stats[n].type = ch->type;
+		n++;
+	}
+	return n;
+}
+
+int smd_get_ch_stats(struct smd_ch_stats *stats, int max)
+{
+	unsigned long flags;
+	int n = 0;
+
+	spin_lock_irqsave(&smd_lock, flags);
+	n += smd_get_list_stats(&smd_ch_list_modem, stats + n, max - n);
+	n += smd_get_list_stats(&smd_ch_list_dsp, stats + n, max - n);
+	n += smd_get_list_stats(&smd_ch_list_dsps, stats + n, max - n);
+	n += smd_get_list_stats(&smd_ch_list_loopback, stats + n, max - n);
+	spin_unlock_irqrestore(&smd_lock, flags);
+
+	return n;
+}
+
 int smd_read_avail(smd_channel_t *ch)
 {
 	return ch->read_avail(ch);
@@ -1858,6 +2198,7 @@ static int __init msm_smd_probe(struct platform_device *pdev)
 	smd_initialized = 1;
 
 	smd_alloc_loopback_channel();
+	smd_alloc_loopback_pkt_channel();
 
 	return 0;
 }
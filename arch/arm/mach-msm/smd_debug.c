@@ -18,6 +18,7 @@
 #include <linux/debugfs.h>
 #include <linux/list.h>
 #include <linux/ctype.h>
+#include <linux/slab.h>
 
 #include <mach/msm_iomap.h>
 
@@ -321,6 +322,38 @@ static int debug_read_ch(char *buf, int max)
 		return debug_read_ch_v1(buf, max);
 }
 
+/* open channels plus the two local loopback channels */
+#define SMD_STATS_MAX (SMD_CHANNELS + 2)
+
+static int debug_read_ch_stats(char *buf, int max)
+{
+	struct smd_ch_stats *st;
+	int n, count, i = 0;
+
+	st = kmalloc(SMD_STATS_MAX * sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return 0;
+
+	count = smd_get_ch_stats(st, SMD_STATS_MAX);
+	i += scnprintf(buf + i, max - i,
+		       "%-20s %4s %8s %8s %8s %8s %8s %10s %10s %6s %6s\n",
+		       "name", "type", "irqs", "wakeups", "w_coal",
+		       "signals", "s_coal", "rx_bytes", "tx_bytes",
+		       "tx_us", "rx_us");
+	for (n = 0; n < count; n++)
+		i += scnprintf(buf + i, max - i,
+			       "%-20s %4u %8u %8u %8u %8u %8u %10lu %10lu "
+			       "%6u %6u\n",
+			       st[n].name, st[n].type, st[n].irqs,
+			       st[n].wakeups, st[n].wakeups_coalesced,
+			       st[n].signals, st[n].signals_coalesced,
+			       st[n].rx_bytes, st[n].tx_bytes,
+			       st[n].tx_coalesce_us, st[n].rx_coalesce_us);
+
+	kfree(st);
+	return i;
+}
+
 static int debug_read_smem_version(char *buf, int max)
 {
 	struct smem_shared *shared = (void *) MSM_SHARED_RAM_BASE;
@@ -472,6 +505,7 @@ static int __init smd_debugfs_init(void)
 		return PTR_ERR(dent);
 
 	debug_create("ch", 0444, dent, debug_read_ch);
+	debug_create("ch_stats", 0444, dent, debug_read_ch_stats);
 	debug_create("diag", 0444, dent, debug_read_diag_msg);
 	debug_create("mem", 0444, dent, debug_read_mem);
 	debug_create("version", 0444, dent, debug_read_smd_version);
@@ -312,6 +312,23 @@ struct smd_half_channel {
 	unsigned head;
 };
 
+struct smd_ch_stats {
+	char name[20];
+	unsigned type;
+	unsigned tx_coalesce_us;
+	unsigned rx_coalesce_us;
+	unsigned irqs;			/* inbound interrupts for the channel */
+	unsigned wakeups;		/* data notifications to the client */
+	unsigned wakeups_coalesced;
+	unsigned signals;		/* interrupts raised to the remote */
+	unsigned signals_coalesced;
+	unsigned long rx_bytes;
+	unsigned long tx_bytes;
+};
+
+/* snapshot of up to max open channels, returns the number filled in */
+int smd_get_ch_stats(struct smd_ch_stats *stats, int max);
+
 extern spinlock_t smem_lock;
 
 
@@ -0,0 +1,208 @@
+/*
+ * drivers/base/power/async_test.c - Dummy devices for async suspend/resume
+ *
+ * Registers a tree of platform devices whose suspend and resume callbacks
+ * just sleep, so that the ordering and the gain of asynchronous device
+ * suspend/resume can be checked on an emulator without real hardware.
+ *
+ * Device i is a child of device (i - 1) / fanout.  In addition every
+ * device declares an explicit dependency on its successor in dpm_list
+ * through device_pm_wait_for_dev().  Each callback checks that the
+ * devices it must follow have already been handled; violations are
+ * counted and reported after every suspend/resume cycle.
+ *
+ * This file is released under the GPLv2
+ */
+
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/delay.h>
+#include <linux/suspend.h>
+
+static int nr_devices = 16;
+module_param(nr_devices, int, S_IRUGO);
+MODULE_PARM_DESC(nr_devices, "number of dummy devices");
+
+static int fanout = 3;
+module_param(fanout, int, S_IRUGO);
+MODULE_PARM_DESC(fanout, "children per dummy device");
+
+static int suspend_delay_ms = 20;
+module_param(suspend_delay_ms, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(suspend_delay_ms, "time each suspend callback takes");
+
+static int resume_delay_ms = 20;
+module_param(resume_delay_ms, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(resume_delay_ms, "time each resume callback takes");
+
+static int async = 1;
+module_param(async, int, S_IRUGO);
+MODULE_PARM_DESC(async, "enable async suspend/resume for the dummy devices");
+
+struct pm_test_dev {
+	struct platform_device	*pdev;
+	int			suspended;
+};
+
+static struct pm_test_dev *test_devs;
+static atomic_t violations;
+static unsigned int cycles;
+
+static struct pm_test_dev *pm_test_parent(int i)
+{
+	return i ? &test_devs[(i - 1) / fanout] : NULL;
+}
+
+static struct pm_test_dev *pm_test_dep(int i)
+{
+	return i + 1 < nr_devices ? &test_devs[i + 1] : NULL;
+}
+
+static void pm_test_violation(struct device *dev, const char *what,
+			      struct pm_test_dev *other)
+{
+	dev_err(dev, "%s before %s\n", what, dev_name(&other->pdev->dev));
+	atomic_inc(&violations);
+}
+
+static int pm_test_suspend(struct device *dev)
+{
+	int i = to_platform_device(dev)->id;
+	struct pm_test_dev *dep = pm_test_dep(i);
+	int child;
+
+	if (dep) {
+		device_pm_wait_for_dev(dev, &dep->pdev->dev);
+		if (!dep->suspended)
+			pm_test_violation(dev, "suspended", dep);
+	}
+	for (child = i * fanout + 1;
+	     child <= i * fanout + fanout && child < nr_devices; child++)
+		if (!test_devs[child].suspended)
+			pm_test_violation(dev, "suspended",
+					  &test_devs[child]);
+
+	msleep(suspend_delay_ms);
+	test_devs[i].suspended = 1;
+	return 0;
+}
+
+static int pm_test_resume(struct device *dev)
+{
+	int i = to_platform_device(dev)->id;
+	struct pm_test_dev *parent = pm_test_parent(i);
+	struct pm_test_dev *prev = i ? &test_devs[i - 1] : NULL;
+
+	if (parent && parent->suspended)
+		pm_test_violation(dev, "resumed", parent);
+	if (prev) {
+		device_pm_wait_for_dev(dev, &prev->pdev->dev);
+		if (prev->suspended)
+			pm_test_violation(dev, "resumed", prev);
+	}
+
+	msleep(resume_delay_ms);
+	test_devs[i].suspended = 0;
+	return 0;
+}
+
+static struct dev_pm_ops pm_test_pm_ops = {
+	.suspend = pm_test_suspend,
+	.resume = pm_test_resume,
+};
+
+static int pm_test_probe(struct platform_device *pdev)
+{
+	return 0;
+}
+
+static struct platform_driver pm_test_driver = {
+	.probe = pm_test_probe,
+	.driver = {
+		.name = "pm_async_test",
+		.owner = THIS_MODULE,
+		.pm = &pm_test_pm_ops,
+	},
+};
+
+static int pm_test_notify(struct notifier_block *nb, unsigned long event,
+			  void *unused)
+{
+	if (event == PM_POST_SUSPEND)
+		printk(KERN_INFO "pm_async_test: cycle %u, %d devices, "
+			"%d ordering violations\n", ++cycles, nr_devices,
+			atomic_read(&violations));
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block pm_test_nb = {
+	.notifier_call = pm_test_notify,
+};
+
+static void pm_test_remove_devices(int count)
+{
+	/* children first */
+	while (count--)
+		platform_device_unregister(test_devs[count].pdev);
+}
+
+static int __init pm_async_test_init(void)
+{
+	struct platform_device *pdev;
+	int ret;
+	int i;
+
+	if (nr_devices <= 0 || fanout <= 0)
+		return -EINVAL;
+
+	test_devs = kcalloc(nr_devices, sizeof(*test_devs), GFP_KERNEL);
+	if (!test_devs)
+		return -ENOMEM;
+
+	ret = platform_driver_register(&pm_test_driver);
+	if (ret)
+		goto err_free;
+
+	for (i = 0; i < nr_devices; i++) {
+		pdev = platform_device_alloc("pm_async_test", i);
+		if (!pdev) {
+			ret = -ENOMEM;
+			goto err_devices;
+		}
+		if (i)
+			pdev->dev.parent = &pm_test_parent(i)->pdev->dev;
+		if (async)
+			device_enable_async_suspend(&pdev->dev);
+		ret = platform_device_add(pdev);
+		if (ret) {
+			platform_device_put(pdev);
+			goto err_devices;
+		}
+		test_devs[i].pdev = pdev;
+	}
+
+	register_pm_notifier(&pm_test_nb);
+	printk(KERN_INFO "pm_async_test: %d devices, fanout %d, %s\n",
+		nr_devices, fanout, async ? "async" : "sync");
+	return 0;
+
+err_devices:
+	pm_test_remove_devices(i);
+	platform_driver_unregister(&pm_test_driver);
+err_free:
+	kfree(test_devs);
+	return ret;
+}
+
+static void __exit pm_async_test_exit(void)
+{
+	unregister_pm_notifier(&pm_test_nb);
+	pm_test_remove_devices(nr_devices);
+	platform_driver_unregister(&pm_test_driver);
+	kfree(test_devs);
+}
+
+module_init(pm_async_test_init);
+module_exit(pm_async_test_exit);
+MODULE_LICENSE("GPL");
@@ -26,6 +26,7 @@
 #include <linux/rwsem.h>
 #include <linux/interrupt.h>
 #include <linux/timer.h>
+#include <linux/async.h>
 
 #include "../base.h"
 #include "power.h"
@@ -43,9 +44,27 @@
 LIST_HEAD(dpm_list);
 
 static DEFINE_MUTEX(dpm_list_mtx);
+static pm_message_t pm_transition;
 
-static void dpm_drv_timeout(unsigned long data);
-static DEFINE_TIMER(dpm_drv_wd, dpm_drv_timeout, 0, 0);
+/*
+ * Set by the first asynchronous suspend callback to fail; the remaining
+ * devices are then left alone and the error is returned to the caller.
+ */
+static int async_error;
+
+/*
+ * The slowest devices of the current suspend or resume phase, longest
+ * first, reported by dpm_show_time() once the phase is over.
+ */
+#define DPM_SLOWEST_NR	4
+
+struct dpm_time_entry {
+	char	name[32];
+	long	usecs;
+};
+
+static struct dpm_time_entry dpm_slowest[DPM_SLOWEST_NR];
+static DEFINE_SPINLOCK(dpm_slowest_lock);
 
 /*
  * Set once the preparation of devices for a PM transition has started, reset
@@ -60,6 +79,8 @@ static bool transition_started;
 void device_pm_init(struct device *dev)
 {
 	dev->power.status = DPM_ON;
+	init_completion(&dev->power.completion);
+	complete_all(&dev->power.completion);
 	pm_runtime_init(dev);
 }
 
@@ -165,6 +186,102 @@ void device_pm_move_last(struct device *dev)
 	list_move_tail(&dev->power.entry, &dpm_list);
 }
 
+static bool is_async(struct device *dev)
+{
+	return dev->power.async_suspend && pm_async_enabled
+		&& !pm_trace_is_enabled();
+}
+
+/**
+ * dpm_wait - Wait for a PM operation to complete.
+ * @dev: Device to wait for.
+ * @async: If unset, wait only if the device's power.async_suspend flag is set.
+ */
+static void dpm_wait(struct device *dev, bool async)
+{
+	if (!dev)
+		return;
+
+	if (async || is_async(dev))
+		wait_for_completion(&dev->power.completion);
+}
+
+static int dpm_wait_fn(struct device *dev, void *async_ptr)
+{
+	dpm_wait(dev, *((bool *)async_ptr));
+	return 0;
+}
+
+static void dpm_wait_for_children(struct device *dev, bool async)
+{
+	device_for_each_child(dev, &async, dpm_wait_fn);
+}
+
+/**
+ * device_pm_wait_for_dev - Wait for suspend/resume of a device to complete.
+ * @subordinate: Device that needs to wait for @dev.
+ * @dev: Device to wait for.
+ *
+ * Lets a driver express an ordering constraint that does not follow the
+ * device hierarchy.  Call it from @subordinate's suspend or resume
+ * callback; @dev must come after @subordinate in dpm_list for suspend
+ * and before it for resume, or the wait may never end.
+ */
+int device_pm_wait_for_dev(struct device *subordinate, struct device *dev)
+{
+	dpm_wait(dev, subordinate->power.async_suspend);
+	return async_error;
+}
+EXPORT_SYMBOL_GPL(device_pm_wait_for_dev);
+
+static void dpm_reset_times(void)
+{
+	spin_lock(&dpm_slowest_lock);
+	memset(dpm_slowest, 0, sizeof(dpm_slowest));
+	spin_unlock(&dpm_slowest_lock);
+}
+
+/**
+ * dpm_record_time - Account the time a device's callbacks took.
+ * @dev: Device that was handled.
+ * @starttime: Time the callbacks were started, not counting the time spent
+ *	waiting for parents or children.
+ */
+static void dpm_record_time(struct device *dev, ktime_t starttime)
+{
+	long usecs = (long)ktime_to_us(ktime_sub(ktime_get(), starttime));
+	int i;
+
+	spin_lock(&dpm_slowest_lock);
+	for (i = 0; i < DPM_SLOWEST_NR; i++)
+		if (usecs > dpm_slowest[i].usecs)
+			break;
+	if (i < DPM_SLOWEST_NR) {
+		memmove(&dpm_slowest[i + 1], &dpm_slowest[i],
+			(DPM_SLOWEST_NR - i - 1) * sizeof(dpm_slowest[0]));
+		strlcpy(dpm_slowest[i].name, dev_name(dev),
+			sizeof(dpm_slowest[i].name));
+		dpm_slowest[i].usecs = usecs;
+	}
+	spin_unlock(&dpm_slowest_lock);
+}
+
+static char *pm_verb(int event);
+
+static void dpm_show_time(ktime_t starttime, pm_message_t state)
+{
+	long usecs = (long)ktime_to_us(ktime_sub(ktime_get(), starttime));
+	int i;
+
+	printk(KERN_INFO "PM: %s of devices complete after %ld.%03ld msecs\n",
+		pm_verb(state.event), usecs / USEC_PER_MSEC,
+		usecs % USEC_PER_MSEC);
+	for (i = 0; i < DPM_SLOWEST_NR && dpm_slowest[i].usecs; i++)
+		printk(KERN_INFO "PM:   %s %ld.%03ld msecs\n",
+			dpm_slowest[i].name, dpm_slowest[i].usecs / USEC_PER_MSEC,
+			dpm_slowest[i].usecs % USEC_PER_MSEC);
+}
+
 /**
  * pm_op - Execute the PM operation appropriate for given PM event.
  * @dev: Device to handle.
@@ -388,15 +505,19 @@ EXPORT_SYMBOL_GPL(dpm_resume_noirq);
  * device_resume - Execute "resume" callbacks for given device.
  * @dev: Device to handle.
  * @state: PM transition of the system being carried out.
+ * @async: If true, the device is being resumed asynchronously.
  */
-static int device_resume(struct device *dev, pm_message_t state)
+static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
+	ktime_t starttime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
+	dpm_wait(dev->parent, async);
 	down(&dev->sem);
+	starttime = ktime_get();
 
 	if (dev->bus) {
 		if (dev->bus->pm) {
@@ -435,12 +556,25 @@ static int device_resume(struct device *dev, pm_message_t state)
 		}
 	}
  End:
+	dpm_record_time(dev, starttime);
 	up(&dev->sem);
+	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
 	return error;
 }
 
+static void async_resume(void *data, async_cookie_t cookie)
+{
+	struct device *dev = (struct device *)data;
+	int error;
+
+	error = device_resume(dev, pm_transition, true);
+	if (error)
+		pm_dev_err(dev, pm_transition, " async", error);
+	put_device(dev);
+}
+
 /**
  *	dpm_drv_timeout - Driver suspend / resume watchdog handler
  *	@data: struct device which timed out
@@ -461,23 +595,27 @@ static void dpm_drv_timeout(unsigned long data)
 
 /**
  *	dpm_drv_wdset - Sets up driver suspend/resume watchdog timer.
+ *	@wd: on-stack timer guarding this call.
  *	@dev: struct device which we're guarding.
  *
+ * 	Each call gets its own timer since devices may be suspended in
+ * 	parallel.
  */
-static void dpm_drv_wdset(struct device *dev)
+static void dpm_drv_wdset(struct timer_list *wd, struct device *dev)
 {
-	dpm_drv_wd.data = (unsigned long) dev;
-	mod_timer(&dpm_drv_wd, jiffies + (HZ * 3));
+	setup_timer_on_stack(wd, dpm_drv_timeout, (unsigned long) dev);
+	mod_timer(wd, jiffies + (HZ * 3));
 }
 
 /**
  *	dpm_drv_wdclr - clears driver suspend/resume watchdog timer.
- *	@dev: struct device which we're no longer guarding.
+ *	@wd: timer set up by dpm_drv_wdset().
  *
  */
-static void dpm_drv_wdclr(struct device *dev)
+static void dpm_drv_wdclr(struct timer_list *wd)
 {
-	del_timer_sync(&dpm_drv_wd);
+	del_timer_sync(wd);
+	destroy_timer_on_stack(wd);
 }
 
 /**
@@ -485,16 +623,35 @@ static void dpm_drv_wdclr(struct device *dev)
  * @state: PM transition of the system being carried out.
  *
  * Execute the appropriate "resume" callback for all devices whose status
- * indicates that they are suspended.
+ * indicates that they are suspended.  Devices with power.async_suspend set
+ * are resumed from async threads, each after its parent; the others are
+ * resumed in dpm_list order as before.
  */
 static void dpm_resume(pm_message_t state)
 {
 	struct list_head list;
+	struct device *dev;
+	ktime_t starttime = ktime_get();
 
 	INIT_LIST_HEAD(&list);
+	dpm_reset_times();
 	mutex_lock(&dpm_list_mtx);
+	pm_transition = state;
+
+	list_for_each_entry(dev, &dpm_list, power.entry) {
+		if (dev->power.status < DPM_OFF)
+			continue;
+
+		INIT_COMPLETION(dev->power.completion);
+		if (is_async(dev)) {
+			dev->power.status = DPM_RESUMING;
+			get_device(dev);
+			async_schedule(async_resume, dev);
+		}
+	}
+
 	while (!list_empty(&dpm_list)) {
-		struct device *dev = to_device(dpm_list.next);
+		dev = to_device(dpm_list.next);
 
 		get_device(dev);
 		if (dev->power.status >= DPM_OFF) {
@@ -503,7 +660,7 @@ static void dpm_resume(pm_message_t state)
 			dev->power.status = DPM_RESUMING;
 			mutex_unlock(&dpm_list_mtx);
 
-			error = device_resume(dev, state);
+			error = device_resume(dev, state, false);
 
 			mutex_lock(&dpm_list_mtx);
 			if (error)
@@ -518,6 +675,8 @@ static void dpm_resume(pm_message_t state)
 	}
 	list_splice(&list, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
+	async_synchronize_full();
+	dpm_show_time(starttime, state);
 }
 
 /**
@@ -673,16 +832,26 @@ int dpm_suspend_noirq(pm_message_t state)
 EXPORT_SYMBOL_GPL(dpm_suspend_noirq);
 
 /**
- * device_suspend - Execute "suspend" callbacks for given device.
+ * __device_suspend - Execute "suspend" callbacks for given device.
  * @dev: Device to handle.
  * @state: PM transition of the system being carried out.
+ * @async: If true, the device is being suspended asynchronously.
  */
-static int device_suspend(struct device *dev, pm_message_t state)
+static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 {
+	struct timer_list wd;
+	ktime_t starttime;
 	int error = 0;
 
+	dpm_wait_for_children(dev, async);
 	down(&dev->sem);
 
+	if (async_error)
+		goto Unlock;
+
+	dpm_drv_wdset(&wd, dev);
+	starttime = ktime_get();
+
 	if (dev->class) {
 		if (dev->class->pm) {
 			pm_dev_dbg(dev, state, "class ");
@@ -722,32 +891,73 @@ static int device_suspend(struct device *dev, pm_message_t state)
 			suspend_report_result(dev->bus->suspend, error);
 		}
 	}
+
+	if (!error)
+		dev->power.status = DPM_OFF;
+
  End:
+	dpm_record_time(dev, starttime);
+	dpm_drv_wdclr(&wd);
+ Unlock:
 	up(&dev->sem);
+	complete_all(&dev->power.completion);
 
 	return error;
 }
 
+static void async_suspend(void *data, async_cookie_t cookie)
+{
+	struct device *dev = (struct device *)data;
+	int error;
+
+	error = __device_suspend(dev, pm_transition, true);
+	if (error) {
+		pm_dev_err(dev, pm_transition, " async", error);
+		async_error = error;
+	}
+
+	put_device(dev);
+}
+
+static int device_suspend(struct device *dev)
+{
+	INIT_COMPLETION(dev->power.completion);
+
+	if (is_async(dev)) {
+		get_device(dev);
+		async_schedule(async_suspend, dev);
+		return 0;
+	}
+
+	return __device_suspend(dev, pm_transition, false);
+}
+
 /**
  * dpm_suspend - Execute "suspend" callbacks for all non-sysdev devices.
  * @state: PM transition of the system being carried out.
+ *
+ * Devices with power.async_suspend set are suspended from async threads
+ * once all of their children are suspended; the others are suspended in
+ * reverse dpm_list order, waiting for any asynchronous children first.
  */
 static int dpm_suspend(pm_message_t state)
 {
 	struct list_head list;
+	ktime_t starttime = ktime_get();
 	int error = 0;
 
 	INIT_LIST_HEAD(&list);
+	dpm_reset_times();
 	mutex_lock(&dpm_list_mtx);
+	pm_transition = state;
+	async_error = 0;
 	while (!list_empty(&dpm_list)) {
 		struct device *dev = to_device(dpm_list.prev);
 
 		get_device(dev);
 		mutex_unlock(&dpm_list_mtx);
 
-		dpm_drv_wdset(dev);
-		error = device_suspend(dev, state);
-		dpm_drv_wdclr(dev);
+		error = device_suspend(dev);
 
 		mutex_lock(&dpm_list_mtx);
 		if (error) {
@@ -755,13 +965,19 @@ static int dpm_suspend(pm_message_t state)
 			put_device(dev);
 			break;
 		}
-		dev->power.status = DPM_OFF;
 		if (!list_empty(&dev->power.entry))
 			list_move(&dev->power.entry, &list);
 		put_device(dev);
+		if (async_error)
+			break;
 	}
 	list_splice(&list, dpm_list.prev);
 	mutex_unlock(&dpm_list_mtx);
+	async_synchronize_full();
+	if (!error)
+		error = async_error;
+	if (!error)
+		dpm_show_time(starttime, state);
 	return error;
 }
 
@@ -17,6 +17,7 @@ static inline void pm_runtime_remove(struct device *dev) {}
  */
 
 extern struct list_head dpm_list;	/* The active device list */
+extern int pm_async_enabled;		/* kernel/power/main.c */
 
 static inline struct device *to_device(struct list_head *entry)
 {
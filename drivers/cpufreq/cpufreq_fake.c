@@ -0,0 +1,145 @@
+/*
+ *  drivers/cpufreq/cpufreq_fake.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * A cpufreq driver with no hardware behind it, for exercising governors
+ * where the platform has no frequency scaling (QEMU, for instance).  Each
+ * CPU gets its own policy over a fixed table of frequencies; a change of
+ * frequency only waits for the configured transition latency and sends
+ * the usual transition notifications, so cpufreq_stats and the
+ * "transitions" attribute of each policy record what the governor did.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/delay.h>
+#include <linux/percpu.h>
+
+static struct cpufreq_frequency_table fake_freq_table[] = {
+	{ 0, 245760 },
+	{ 1, 368640 },
+	{ 2, 768000 },
+	{ 3, 1024000 },
+	{ 4, CPUFREQ_TABLE_END },
+};
+
+/* Time a frequency change takes, in usecs */
+static unsigned int transition_latency = 50;
+module_param(transition_latency, uint, 0444);
+MODULE_PARM_DESC(transition_latency, "simulated transition latency, in usecs");
+
+static DEFINE_PER_CPU(unsigned int, fake_cur_freq);
+static DEFINE_PER_CPU(unsigned long, fake_transitions);
+
+static int fake_cpufreq_target(struct cpufreq_policy *policy,
+			       unsigned int target_freq,
+			       unsigned int relation)
+{
+	struct cpufreq_freqs freqs;
+	unsigned int index;
+
+	if (cpufreq_frequency_table_target(policy, fake_freq_table,
+					   target_freq, relation, &index))
+		return -EINVAL;
+
+	freqs.old = per_cpu(fake_cur_freq, policy->cpu);
+	freqs.new = fake_freq_table[index].frequency;
+	freqs.cpu = policy->cpu;
+	if (freqs.old == freqs.new)
+		return 0;
+
+	cpufreq_notify_transition(&freqs, CPUFREQ_PRECHANGE);
+	if (transition_latency >= 1000)
+		msleep(DIV_ROUND_UP(transition_latency, 1000));
+	else
+		udelay(transition_latency);
+	per_cpu(fake_cur_freq, policy->cpu) = freqs.new;
+	per_cpu(fake_transitions, policy->cpu)++;
+	cpufreq_notify_transition(&freqs, CPUFREQ_POSTCHANGE);
+
+	return 0;
+}
+
+static int fake_cpufreq_verify(struct cpufreq_policy *policy)
+{
+	return cpufreq_frequency_table_verify(policy, fake_freq_table);
+}
+
+static unsigned int fake_cpufreq_get(unsigned int cpu)
+{
+	return per_cpu(fake_cur_freq, cpu);
+}
+
+static int fake_cpufreq_init(struct cpufreq_policy *policy)
+{
+	int ret;
+
+	ret = cpufreq_frequency_table_cpuinfo(policy, fake_freq_table);
+	if (ret)
+		return ret;
+
+	/* Start at the top speed, as a bootloader usually leaves it */
+	if (!per_cpu(fake_cur_freq, policy->cpu))
+		per_cpu(fake_cur_freq, policy->cpu) = policy->cpuinfo.max_freq;
+	policy->cur = per_cpu(fake_cur_freq, policy->cpu);
+	policy->cpuinfo.transition_latency =
+		transition_latency * NSEC_PER_USEC;
+	cpufreq_frequency_table_get_attr(fake_freq_table, policy->cpu);
+
+	return 0;
+}
+
+static int fake_cpufreq_exit(struct cpufreq_policy *policy)
+{
+	cpufreq_frequency_table_put_attr(policy->cpu);
+	return 0;
+}
+
+static ssize_t show_transitions(struct cpufreq_policy *policy, char *buf)
+{
+	return sprintf(buf, "%lu\n", per_cpu(fake_transitions, policy->cpu));
+}
+
+static struct freq_attr fake_cpufreq_transitions =
+	__ATTR(transitions, 0444, show_transitions, NULL);
+
+static struct freq_attr *fake_cpufreq_attr[] = {
+	&cpufreq_freq_attr_scaling_available_freqs,
+	&fake_cpufreq_transitions,
+	NULL,
+};
+
+static struct cpufreq_driver fake_cpufreq_driver = {
+	.flags		= CPUFREQ_STICKY | CPUFREQ_CONST_LOOPS,
+	.init		= fake_cpufreq_init,
+	.exit		= fake_cpufreq_exit,
+	.verify		= fake_cpufreq_verify,
+	.target		= fake_cpufreq_target,
+	.get		= fake_cpufreq_get,
+	.name		= "fake",
+	.owner		= THIS_MODULE,
+	.attr		= fake_cpufreq_attr,
+};
+
+static int __init fake_cpufreq_register(void)
+{
+	printk(KERN_WARNING "cpufreq: registering fake driver, "
+	       "for governor testing only\n");
+	return cpufreq_register_driver(&fake_cpufreq_driver);
+}
+
+static void __exit fake_cpufreq_unregister(void)
+{
+	cpufreq_unregister_driver(&fake_cpufreq_driver);
+}
+
+module_init(fake_cpufreq_register);
+module_exit(fake_cpufreq_unregister);
+
+MODULE_DESCRIPTION("Fake cpufreq driver for governor testing");
+MODULE_LICENSE("GPL");
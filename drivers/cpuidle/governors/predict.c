@@ -0,0 +1,604 @@
+/*
+ * predict.c - the prediction idle governor
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos_params.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/err.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+/*
+ * Concepts behind the predict governor
+ *
+ * The idle duration is bounded by the next timer event, but most idle
+ * periods on a phone end early because of a device interrupt: touch
+ * samples, audio DMA buffers, modem SMD traffic.  Those interrupts tend
+ * to be periodic, so for the few interrupts seen most recently on each
+ * CPU we track the average interval between them.  Once an interrupt
+ * has arrived at a steady interval IRQ_MIN_HITS times in a row, its next
+ * arrival is predicted to be one interval after the last one.  The
+ * predicted idle duration is the earliest of the next timer event and
+ * the predicted interrupts.
+ *
+ * The exit latency a driver declares for a state is often optimistic.
+ * Whenever an idle period ends with the timer, the time spent past the
+ * timer expiry is the state's real exit latency; a running average of
+ * it is kept per state, and the larger of declared and measured latency
+ * is checked against the PM_QOS_CPU_DMA_LATENCY constraint and the
+ * prediction.
+ *
+ * The deepest state whose target residency fits the prediction and
+ * whose latency fits the constraint is selected.
+ *
+ * For tuning, the idle periods can be recorded to a ring buffer in
+ * debugfs and written back to the replay file, which runs the same
+ * prediction on a simulated CPU and reports how often it picked a state
+ * too deep or too shallow for the idle period that followed.
+ */
+
+#define IRQ_SLOTS		8
+#define IRQ_MIN_HITS		3
+#define IRQ_MAX_INTERVAL	(USEC_PER_SEC)
+#define EXIT_DECAY		8
+#define EXIT_MAX_SAMPLE		10000
+#define TRACE_SIZE		512
+
+struct predict_irq {
+	int		irq;
+	unsigned int	hits;
+	unsigned int	interval_us;
+	s64		last_us;
+};
+
+struct predict_device {
+	struct predict_irq	irqs[IRQ_SLOTS];
+	unsigned int		exit_us[CPUIDLE_STATE_MAX];
+	int			last_state_idx;
+	int			needs_update;
+	int			in_idle;
+	int			wake_irq;
+	unsigned int		timer_us;
+	unsigned int		predicted_us;
+	s64			entry_us;
+	s64			exit_time_us;
+};
+
+static DEFINE_PER_CPU(struct predict_device, predict_devices);
+/* number of CPUs using the governor */
+static atomic_t predict_enabled = ATOMIC_INIT(0);
+
+static void predict_reset(struct predict_device *data,
+			  struct cpuidle_state *states, int count)
+{
+	int i;
+
+	memset(data, 0, sizeof(*data));
+	for (i = 0; i < IRQ_SLOTS; i++)
+		data->irqs[i].irq = -1;
+	for (i = 0; i < count; i++)
+		data->exit_us[i] = states[i].exit_latency;
+	data->wake_irq = -1;
+}
+
+/* Account an interrupt arriving at @now_us */
+static void predict_irq_event(struct predict_device *data, int irq,
+			      s64 now_us)
+{
+	struct predict_irq *p, *victim = &data->irqs[0];
+	unsigned int interval;
+	int i;
+
+	for (i = 0; i < IRQ_SLOTS; i++) {
+		p = &data->irqs[i];
+		if (p->irq == irq)
+			goto found;
+		if (p->last_us < victim->last_us)
+			victim = p;
+	}
+
+	victim->irq = irq;
+	victim->hits = 0;
+	victim->interval_us = 0;
+	victim->last_us = now_us;
+	return;
+
+found:
+	if (now_us - p->last_us > IRQ_MAX_INTERVAL) {
+		p->hits = 0;
+		p->interval_us = 0;
+		p->last_us = now_us;
+		return;
+	}
+	interval = now_us - p->last_us;
+	p->last_us = now_us;
+
+	if (p->interval_us && interval >= p->interval_us / 2 &&
+	    interval <= p->interval_us * 2) {
+		p->interval_us = (p->interval_us * 3 + interval) / 4;
+		if (p->hits < IRQ_MIN_HITS)
+			p->hits++;
+	} else {
+		p->interval_us = interval;
+		p->hits = 1;
+	}
+}
+
+/* Time until the earliest predicted interrupt, or UINT_MAX */
+static unsigned int predict_next_irq(struct predict_device *data, s64 now_us)
+{
+	unsigned int next_us = UINT_MAX;
+	int i;
+
+	for (i = 0; i < IRQ_SLOTS; i++) {
+		struct predict_irq *p = &data->irqs[i];
+		s64 next;
+
+		if (p->hits < IRQ_MIN_HITS)
+			continue;
+		next = p->last_us + p->interval_us;
+		if (next <= now_us)
+			continue;
+		if (next - now_us < next_us)
+			next_us = next - now_us;
+	}
+	return next_us;
+}
+
+static unsigned int state_latency(struct predict_device *data,
+				  struct cpuidle_state *states, int i)
+{
+	return max(states[i].exit_latency, data->exit_us[i]);
+}
+
+static int predict_pick(struct predict_device *data,
+			struct cpuidle_state *states, int count,
+			unsigned int timer_us, s64 now_us, int latency_req)
+{
+	unsigned int predicted_us;
+	int idx = CPUIDLE_DRIVER_STATE_START;
+	int i;
+
+	predicted_us = min(timer_us, predict_next_irq(data, now_us));
+	data->timer_us = timer_us;
+	data->predicted_us = predicted_us;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0)) {
+		data->last_state_idx = 0;
+		return 0;
+	}
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i < count; i++) {
+		struct cpuidle_state *s = &states[i];
+		unsigned int latency = state_latency(data, states, i);
+
+		if (s->flags & CPUIDLE_FLAG_IGNORE)
+			continue;
+		if (s->target_residency > predicted_us)
+			continue;
+		if (latency > latency_req || latency > predicted_us)
+			continue;
+		idx = i;
+	}
+
+	data->last_state_idx = idx;
+	return idx;
+}
+
+/* Learn the exit latency of the state used from how long it took */
+static void predict_learn(struct predict_device *data, unsigned int idle_us)
+{
+	int idx = data->last_state_idx;
+	unsigned int sample;
+
+	if (idle_us < data->timer_us)
+		return;
+
+	sample = min_t(unsigned int, idle_us - data->timer_us,
+		       EXIT_MAX_SAMPLE);
+	data->exit_us[idx] = (data->exit_us[idx] * (EXIT_DECAY - 1) + sample)
+				/ EXIT_DECAY;
+}
+
+/*
+ * Idle trace recording.
+ */
+
+struct predict_sample {
+	u32	busy_us;
+	u32	timer_us;
+	u32	idle_us;
+	s32	wake_irq;
+};
+
+static u32 trace_enabled;
+static struct predict_sample trace_buf[TRACE_SIZE];
+static unsigned int trace_head, trace_len;
+static DEFINE_SPINLOCK(trace_lock);
+
+static void predict_trace(struct predict_device *data, unsigned int idle_us)
+{
+	struct predict_sample *s;
+
+	spin_lock(&trace_lock);
+	s = &trace_buf[trace_head];
+	s->busy_us = data->exit_time_us ?
+		data->entry_us - data->exit_time_us : 0;
+	s->timer_us = data->timer_us;
+	s->idle_us = idle_us;
+	s->wake_irq = data->wake_irq;
+	trace_head = (trace_head + 1) % TRACE_SIZE;
+	if (trace_len < TRACE_SIZE)
+		trace_len++;
+	spin_unlock(&trace_lock);
+}
+
+/**
+ * cpuidle_predict_irq - account an interrupt for idle prediction
+ * @irq: the interrupt number
+ *
+ * Called from handle_IRQ_event() with interrupts disabled, except for
+ * the clockevent interrupt, whose next expiry is already the timer bound.
+ */
+void cpuidle_predict_irq(unsigned int irq)
+{
+	struct predict_device *data;
+
+	if (!atomic_read(&predict_enabled))
+		return;
+
+	data = &__get_cpu_var(predict_devices);
+	if (data->in_idle) {
+		data->in_idle = 0;
+		data->wake_irq = irq;
+	}
+	predict_irq_event(data, irq, ktime_to_us(ktime_get()));
+}
+
+/**
+ * predict_update - learn from the idle period that just ended
+ * @dev: the CPU
+ */
+static void predict_update(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	struct cpuidle_state *target = &dev->states[data->last_state_idx];
+	unsigned int idle_us;
+
+	if (target->flags & CPUIDLE_FLAG_TIME_VALID)
+		idle_us = cpuidle_get_last_residency(dev);
+	else
+		idle_us = data->predicted_us;
+
+	predict_learn(data, idle_us);
+	if (trace_enabled)
+		predict_trace(data, idle_us);
+
+	data->in_idle = 0;
+	data->exit_time_us = data->entry_us + idle_us;
+}
+
+/**
+ * predict_select - selects the next idle state to enter
+ * @dev: the CPU
+ */
+static int predict_select(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	int latency_req = pm_qos_requirement(PM_QOS_CPU_DMA_LATENCY);
+	s64 sleep_us = ktime_to_us(tick_nohz_get_sleep_length());
+	s64 now_us = ktime_to_us(ktime_get());
+	int idx;
+
+	if (data->needs_update) {
+		predict_update(dev);
+		data->needs_update = 0;
+	}
+
+	idx = predict_pick(data, dev->states, dev->state_count,
+			   (unsigned int)min_t(s64, sleep_us, UINT_MAX),
+			   now_us, latency_req);
+
+	data->entry_us = now_us;
+	data->wake_irq = -1;
+	data->in_idle = 1;
+	return idx;
+}
+
+/**
+ * predict_reflect - records that data structures need update
+ * @dev: the CPU
+ */
+static void predict_reflect(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	data->needs_update = 1;
+}
+
+/**
+ * predict_enable_device - scans a CPU's states and does setup
+ * @dev: the CPU
+ */
+static int predict_enable_device(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &per_cpu(predict_devices, dev->cpu);
+
+	predict_reset(data, dev->states, dev->state_count);
+	atomic_inc(&predict_enabled);
+	return 0;
+}
+
+/**
+ * predict_disable_device - stops tracking interrupts for a CPU
+ * @dev: the CPU
+ */
+static void predict_disable_device(struct cpuidle_device *dev)
+{
+	atomic_dec(&predict_enabled);
+}
+
+static struct cpuidle_governor predict_governor = {
+	.name =		"predict",
+	.rating =	15,
+	.enable =	predict_enable_device,
+	.disable =	predict_disable_device,
+	.select =	predict_select,
+	.reflect =	predict_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/*
+ * Trace replay.
+ *
+ * Lines written to <debugfs>/cpuidle_predict/replay are either
+ *	state <exit_latency_us> <target_residency_us>
+ * to append a state to the simulated CPU (by default it has the states of
+ * CPU 0), or
+ *	<busy_us> <timer_us> <idle_us> <wake_irq>
+ * as produced by the trace file, to simulate one idle period.  Writing
+ * "reset" clears the simulation.  Reading the file reports the results.
+ */
+
+static DEFINE_MUTEX(replay_mutex);
+static struct predict_device replay_dev;
+static struct cpuidle_state replay_states[CPUIDLE_STATE_MAX];
+static int replay_count;
+static s64 replay_now_us;
+static unsigned long replay_samples, replay_too_deep, replay_too_shallow;
+static unsigned long replay_usage[CPUIDLE_STATE_MAX];
+
+static void replay_reset(void)
+{
+	memset(replay_states, 0, sizeof(replay_states));
+	replay_count = 0;
+	replay_now_us = 0;
+	replay_samples = replay_too_deep = replay_too_shallow = 0;
+	memset(replay_usage, 0, sizeof(replay_usage));
+	predict_reset(&replay_dev, replay_states, 0);
+}
+
+static void replay_default_states(void)
+{
+	struct cpuidle_device *dev = per_cpu(cpuidle_devices, 0);
+
+	if (replay_count || !dev)
+		return;
+	replay_count = dev->state_count;
+	memcpy(replay_states, dev->states, sizeof(replay_states));
+	predict_reset(&replay_dev, replay_states, replay_count);
+}
+
+/* The deepest state that would have paid off for @idle_us */
+static int replay_ideal(unsigned int idle_us)
+{
+	int idx = CPUIDLE_DRIVER_STATE_START;
+	int i;
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i < replay_count; i++)
+		if (replay_states[i].target_residency <= idle_us)
+			idx = i;
+	return idx;
+}
+
+static void replay_sample(u32 busy_us, u32 timer_us, u32 idle_us,
+			  int wake_irq)
+{
+	int idx, ideal;
+
+	replay_default_states();
+	if (!replay_count)
+		return;
+
+	replay_now_us += busy_us;
+	idx = predict_pick(&replay_dev, replay_states, replay_count,
+			   timer_us, replay_now_us, INT_MAX);
+	replay_now_us += idle_us;
+	if (wake_irq >= 0)
+		predict_irq_event(&replay_dev, wake_irq, replay_now_us);
+	predict_learn(&replay_dev, idle_us);
+
+	ideal = replay_ideal(idle_us);
+	replay_samples++;
+	replay_usage[idx]++;
+	if (idx > ideal)
+		replay_too_deep++;
+	else if (idx < ideal)
+		replay_too_shallow++;
+}
+
+static int replay_line(char *line)
+{
+	unsigned int a, b, c;
+	int irq;
+
+	if (!strncmp(line, "reset", 5)) {
+		replay_reset();
+		return 0;
+	}
+	if (sscanf(line, "state %u %u", &a, &b) == 2) {
+		if (replay_count >= CPUIDLE_STATE_MAX)
+			return -ENOSPC;
+		snprintf(replay_states[replay_count].name, CPUIDLE_NAME_LEN,
+			 "S%d", replay_count);
+		replay_states[replay_count].exit_latency = a;
+		replay_states[replay_count].target_residency = b;
+		replay_dev.exit_us[replay_count] = a;
+		replay_count++;
+		return 0;
+	}
+	if (sscanf(line, "%u %u %u %d", &a, &b, &c, &irq) == 4) {
+		replay_sample(a, b, c, irq);
+		return 0;
+	}
+	return -EINVAL;
+}
+
+static ssize_t replay_write(struct file *file, const char __user *ubuf,
+			    size_t count, loff_t *ppos)
+{
+	char *buf, *line, *next;
+	int ret = 0;
+
+	if (count > PAGE_SIZE)
+		count = PAGE_SIZE;
+	buf = kmalloc(count + 1, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	if (copy_from_user(buf, ubuf, count)) {
+		kfree(buf);
+		return -EFAULT;
+	}
+	buf[count] = '\0';
+
+	/* only consume complete lines, the rest comes with the next write */
+	line = buf;
+	mutex_lock(&replay_mutex);
+	while ((next = strchr(line, '\n'))) {
+		*next = '\0';
+		if (*line && replay_line(line) && !ret)
+			ret = -EINVAL;
+		line = next + 1;
+	}
+	if (line == buf && *line) {
+		/* a single line without newline */
+		if (replay_line(line))
+			ret = -EINVAL;
+		line += strlen(line);
+	}
+	mutex_unlock(&replay_mutex);
+
+	count = line - buf;
+	kfree(buf);
+	return ret ? ret : count;
+}
+
+static int replay_show(struct seq_file *m, void *unused)
+{
+	int i;
+
+	mutex_lock(&replay_mutex);
+	seq_printf(m, "samples: %lu\ntoo deep: %lu\ntoo shallow: %lu\n",
+		   replay_samples, replay_too_deep, replay_too_shallow);
+	for (i = 0; i < replay_count; i++)
+		seq_printf(m, "%s: exit %u us (measured %u us), residency %u us,"
+			   " selected %lu\n", replay_states[i].name,
+			   replay_states[i].exit_latency, replay_dev.exit_us[i],
+			   replay_states[i].target_residency, replay_usage[i]);
+	mutex_unlock(&replay_mutex);
+	return 0;
+}
+
+static int replay_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, replay_show, NULL);
+}
+
+static const struct file_operations replay_fops = {
+	.open = replay_open,
+	.read = seq_read,
+	.write = replay_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int trace_show(struct seq_file *m, void *unused)
+{
+	static struct predict_sample copy[TRACE_SIZE];
+	static DEFINE_MUTEX(copy_mutex);
+	unsigned int i, head, len;
+
+	mutex_lock(&copy_mutex);
+	spin_lock_irq(&trace_lock);
+	memcpy(copy, trace_buf, sizeof(copy));
+	head = trace_head;
+	len = trace_len;
+	spin_unlock_irq(&trace_lock);
+
+	for (i = 0; i < len; i++) {
+		struct predict_sample *s =
+			&copy[(head + TRACE_SIZE - len + i) % TRACE_SIZE];
+		seq_printf(m, "%u %u %u %d\n", s->busy_us, s->timer_us,
+			   s->idle_us, s->wake_irq);
+	}
+	mutex_unlock(&copy_mutex);
+	return 0;
+}
+
+static int trace_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, trace_show, NULL);
+}
+
+static const struct file_operations trace_fops = {
+	.open = trace_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void __init predict_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("cpuidle_predict", NULL);
+	if (!dir || IS_ERR(dir))
+		return;
+	debugfs_create_bool("record", S_IRUGO | S_IWUSR, dir, &trace_enabled);
+	debugfs_create_file("trace", S_IRUGO, dir, NULL, &trace_fops);
+	debugfs_create_file("replay", S_IRUGO | S_IWUSR, dir, NULL,
+			    &replay_fops);
+}
+
+/**
+ * init_predict - initializes the governor
+ */
+static int __init init_predict(void)
+{
+	replay_reset();
+	predict_debugfs_init();
+	return cpuidle_register_governor(&predict_governor);
+}
+
+/**
+ * exit_predict - exits the governor
+ */
+static void __exit exit_predict(void)
+{
+	cpuidle_unregister_governor(&predict_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_predict);
+module_exit(exit_predict);
@@ -50,6 +50,22 @@
 
 #define HEADROOM_FOR_QOS    8
 
+/* Packets taken from the SMD FIFO per NAPI poll */
+#define RMNET_NAPI_WEIGHT	64
+
+/* Receive buffers recycled from transmit completions */
+#define RMNET_RX_BUF_SIZE	(RMNET_DATA_LEN + ETH_HLEN + NET_IP_ALIGN)
+#define RMNET_RX_RECYCLE_MAX	RMNET_NAPI_WEIGHT
+
+/* Larger packets are received into page fragments; the head of such an
+ * skb only needs room for the headers the stack pulls on demand.
+ */
+#define RMNET_RX_COPYBREAK	128
+#define RMNET_RX_HDR_ROOM	128
+
+/* Packets written to the FIFO before the modem is signalled */
+#define RMNET_TX_BATCH		8
+
 static const char *ch_name[8] = {
 	"DATA5",
 	"DATA6",
@@ -74,7 +90,17 @@ struct rmnet_private
 	unsigned long wakeups_xmit;
 	unsigned long wakeups_rcv;
 	unsigned long timeout_us;
+	unsigned long rx_polls;
+	unsigned long rx_budget_hits;
+	unsigned long rx_recycled;
+	unsigned long tx_kicks;
 #endif
+	struct napi_struct napi;
+	struct sk_buff_head rx_recycle;
+	struct skb_frag_cache rx_frag_cache;
+	atomic_t tx_pending;	/* packets written but not signalled */
+	struct tasklet_struct tx_kick;
+	int loopback;
 	struct sk_buff *skb;
 	spinlock_t lock;
 	struct tasklet_struct tsklt;
@@ -89,6 +115,14 @@ static uint msm_rmnet_modem_wait;
 module_param_named(modem_wait, msm_rmnet_modem_wait,
 		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* Run rmnet0 over the local SMD loopback channel instead of the modem */
+static uint msm_rmnet_loopback;
+module_param_named(loopback, msm_rmnet_loopback, uint, S_IRUGO);
+
+/* Receive packets above RMNET_RX_COPYBREAK into shared page fragments */
+static uint msm_rmnet_rx_frags = 1;
+module_param_named(rx_frags, msm_rmnet_rx_frags, uint, S_IRUGO | S_IWUSR);
+
 /* Forward declaration */
 static int rmnet_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd);
 
@@ -216,16 +250,35 @@ static ssize_t timeout_show(struct device *d, struct device_attribute *attr,
 }
 
 DEVICE_ATTR(timeout, 0664, timeout_show, timeout_store);
+
+static ssize_t napi_stats_show(struct device *d, struct device_attribute *attr,
+			       char *buf)
+{
+	struct rmnet_private *p = netdev_priv(to_net_dev(d));
+	return sprintf(buf, "polls %lu budget_hits %lu recycled %lu "
+		       "tx_kicks %lu\n", p->rx_polls, p->rx_budget_hits,
+		       p->rx_recycled, p->tx_kicks);
+}
+
+DEVICE_ATTR(napi_stats, 0444, napi_stats_show, NULL);
 #endif
 
 static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
 {
 	__be16 protocol = 0;
+	u8 _ver, *ver;
 
 	skb->dev = dev;
+	skb_reset_mac_header(skb);
+	skb_reset_network_header(skb);
+
+	/* the IP header may still be in a page fragment */
+	ver = skb_header_pointer(skb, 0, 1, &_ver);
+	if (ver == NULL)
+		return 0;
 
 	/* Determine L3 protocol */
-	switch (skb->data[0] & 0xf0) {
+	switch (*ver & 0xf0) {
 	case 0x40:
 		protocol = htons(ETH_P_IP);
 		break;
@@ -234,82 +287,199 @@ static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
 		break;
 	default:
 		pr_err("rmnet_recv() L3 protocol decode error: 0x%02x",
-		       skb->data[0] & 0xf0);
+		       *ver & 0xf0);
 		/* skb will be dropped in uppder layer for unknown protocol */
 	}
 	return protocol;
 }
 
-/* Called in soft-irq context */
-static void smd_net_data_handler(unsigned long arg)
+/* Returns the size of the next complete packet in the FIFO, 0 if none */
+static int rmnet_rx_ready(smd_channel_t *ch)
+{
+	int sz = smd_cur_packet_size(ch);
+
+	if (sz == 0 || smd_read_avail(ch) < sz)
+		return 0;
+	return sz;
+}
+
+static struct sk_buff *rmnet_alloc_rx_skb(struct net_device *dev, int sz)
 {
-	struct net_device *dev = (struct net_device *) arg;
 	struct rmnet_private *p = netdev_priv(dev);
 	struct sk_buff *skb;
-	void *ptr = 0;
-	int sz;
-	u32 opmode = p->operation_mode;
-	unsigned long flags;
 
-	for (;;) {
-		sz = smd_cur_packet_size(p->ch);
-		if (sz == 0) break;
-		if (smd_read_avail(p->ch) < sz) break;
+	skb = skb_dequeue(&p->rx_recycle);
+	if (skb) {
+		skb->dev = dev;
+#ifdef CONFIG_MSM_RMNET_DEBUG
+		p->rx_recycled++;
+#endif
+	} else {
+		skb = netdev_alloc_skb(dev, sz + NET_IP_ALIGN);
+		if (skb == NULL)
+			return NULL;
+	}
+	skb_reserve(skb, NET_IP_ALIGN);
+	return skb;
+}
+
+/*
+ * Allocate an skb for a packet of sz bytes whose first hlen bytes go in
+ * the linear head and the rest in a page fragment returned in *frag.
+ * The length is set up already; the caller only fills in the data.
+ */
+static struct sk_buff *rmnet_alloc_rx_frag_skb(struct net_device *dev,
+					       int sz, int hlen, void **frag)
+{
+	struct rmnet_private *p = netdev_priv(dev);
+	struct sk_buff *skb;
+	struct page *page;
+	unsigned int off;
+
+	skb = netdev_alloc_skb(dev, RMNET_RX_HDR_ROOM + NET_IP_ALIGN);
+	if (skb == NULL)
+		return NULL;
+	if (skb_frag_cache_alloc(&p->rx_frag_cache, sz - hlen, GFP_ATOMIC,
+				 &page, &off)) {
+		dev_kfree_skb_any(skb);
+		return NULL;
+	}
+
+	skb_reserve(skb, NET_IP_ALIGN);
+	skb_put(skb, hlen);
+	skb_add_rx_frag(skb, 0, page, off, sz - hlen);
+	*frag = page_address(page) + off;
+	return skb;
+}
+
+/* Keep a transmitted skb for the receive path if it is big enough */
+static void rmnet_free_tx_skb(struct rmnet_private *p, struct sk_buff *skb)
+{
+	if (skb_queue_len(&p->rx_recycle) < RMNET_RX_RECYCLE_MAX &&
+	    skb_recycle_check(skb, RMNET_RX_BUF_SIZE))
+		skb_queue_head(&p->rx_recycle, skb);
+	else
+		dev_kfree_skb_any(skb);
+}
+
+/* Called in soft-irq context */
+static int rmnet_poll(struct napi_struct *napi, int budget)
+{
+	struct net_device *dev = napi->dev;
+	struct rmnet_private *p = netdev_priv(dev);
+	smd_channel_t *ch = p->ch;
+	struct sk_buff *skb;
+	void *ptr, *frag;
+	int sz, max_len, hlen;
+	int work = 0;
+	u32 opmode = ACCESS_ONCE(p->operation_mode);
+
+	max_len = RMNET_IS_MODE_IP(opmode) ? dev->mtu : (dev->mtu + ETH_HLEN);
+	/* eth_type_trans() needs the link header in the skb head */
+	hlen = RMNET_IS_MODE_IP(opmode) ? 0 : ETH_HLEN;
+
+	while (ch && work < budget) {
+		sz = rmnet_rx_ready(ch);
+		if (sz == 0)
+			break;
+		work++;
 
-		if (RMNET_IS_MODE_IP(opmode) ? (sz > dev->mtu) :
-						(sz > (dev->mtu + ETH_HLEN))) {
+		if (sz > max_len) {
 			pr_err("rmnet_recv() discarding %d len (%d mtu)\n",
-				sz, RMNET_IS_MODE_IP(opmode) ?
-					dev->mtu : (dev->mtu + ETH_HLEN));
-			ptr = 0;
+				sz, max_len);
+			goto discard;
+		}
+
+		if (msm_rmnet_rx_frags && sz > RMNET_RX_COPYBREAK)
+			skb = rmnet_alloc_rx_frag_skb(dev, sz, hlen, &frag);
+		else
+			skb = rmnet_alloc_rx_skb(dev, sz);
+		if (skb == NULL) {
+			pr_err("rmnet_recv() cannot allocate skb\n");
+			p->stats.rx_dropped++;
+			goto discard;
+		}
+
+		if (skb_is_nonlinear(skb)) {
+			ptr = skb->data;
+			if ((hlen && smd_read(ch, ptr, hlen) != hlen) ||
+			    smd_read(ch, frag, sz - hlen) != sz - hlen) {
+				pr_err("rmnet_recv() smd lied about avail?!");
+				dev_kfree_skb_any(skb);
+				continue;
+			}
 		} else {
-			skb = dev_alloc_skb(sz + NET_IP_ALIGN);
-			if (skb == NULL) {
-				pr_err("rmnet_recv() cannot allocate skb\n");
-			} else {
-				skb->dev = dev;
-				skb_reserve(skb, NET_IP_ALIGN);
-				ptr = skb_put(skb, sz);
-				wake_lock_timeout(&p->wake_lock, HZ / 2);
-				if (smd_read(p->ch, ptr, sz) != sz) {
-					pr_err("rmnet_recv() smd lied about avail?!");
-					ptr = 0;
-					dev_kfree_skb_irq(skb);
-				} else {
-					/* Handle Rx frame format */
-					spin_lock_irqsave(&p->lock, flags);
-					opmode = p->operation_mode;
-					spin_unlock_irqrestore(&p->lock, flags);
-
-					if (RMNET_IS_MODE_IP(opmode)) {
-						/* Driver in IP mode */
-						skb->protocol =
-						  rmnet_ip_type_trans(skb, dev);
-					} else {
-						/* Driver in Ethernet mode */
-						skb->protocol =
-						  eth_type_trans(skb, dev);
-					}
-					if (RMNET_IS_MODE_IP(opmode) ||
-					    count_this_packet(ptr, skb->len)) {
-#ifdef CONFIG_MSM_RMNET_DEBUG
-						p->wakeups_rcv +=
-							rmnet_cause_wakeup(p);
-#endif
-						p->stats.rx_packets++;
-						p->stats.rx_bytes += skb->len;
-					}
-					netif_rx(skb);
-				}
+			ptr = skb_put(skb, sz);
+			if (smd_read(ch, ptr, sz) != sz) {
+				pr_err("rmnet_recv() smd lied about avail?!");
+				dev_kfree_skb_any(skb);
 				continue;
 			}
 		}
-		if (smd_read(p->ch, ptr, sz) != sz)
+
+		/* Handle Rx frame format */
+		if (RMNET_IS_MODE_IP(opmode)) {
+			/* Driver in IP mode */
+			skb->protocol = rmnet_ip_type_trans(skb, dev);
+		} else {
+			/* Driver in Ethernet mode */
+			skb->protocol = eth_type_trans(skb, dev);
+		}
+		if (RMNET_IS_MODE_IP(opmode) ||
+		    count_this_packet(ptr, skb->len)) {
+#ifdef CONFIG_MSM_RMNET_DEBUG
+			p->wakeups_rcv += rmnet_cause_wakeup(p);
+#endif
+			p->stats.rx_packets++;
+			p->stats.rx_bytes += skb->len;
+		}
+		/*
+		 * GRO matches flows on the link-layer header, which raw IP
+		 * frames do not have, so it never merges them.
+		 */
+		if (RMNET_IS_MODE_IP(opmode))
+			netif_receive_skb(skb);
+		else
+			napi_gro_receive(napi, skb);
+		continue;
+
+discard:
+		if (smd_read(ch, NULL, sz) != sz)
 			pr_err("rmnet_recv() smd lied about avail?!");
 	}
+
+	if (work)
+		wake_lock_timeout(&p->wake_lock, HZ / 2);
+
+#ifdef CONFIG_MSM_RMNET_DEBUG
+	p->rx_polls++;
+	if (work == budget)
+		p->rx_budget_hits++;
+#endif
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* a notification that raced with the poll was dropped */
+		if (ch && rmnet_rx_ready(ch))
+			napi_reschedule(napi);
+	}
+	return work;
 }
 
-static DECLARE_TASKLET(smd_net_data_tasklet, smd_net_data_handler, 0);
+/* Signal the modem for packets left over from the last batch */
+static void _rmnet_tx_kick(unsigned long param)
+{
+	struct net_device *dev = (struct net_device *)param;
+	struct rmnet_private *p = netdev_priv(dev);
+	smd_channel_t *ch = p->ch;
+
+	if (atomic_xchg(&p->tx_pending, 0) && ch) {
+		smd_write_kick(ch);
+#ifdef CONFIG_MSM_RMNET_DEBUG
+		p->tx_kicks++;
+#endif
+	}
+}
 
 static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 {
@@ -317,6 +487,9 @@ static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 	smd_channel_t *ch = p->ch;
 	int smd_ret;
 	struct QMI_QOS_HDR_S *qmih;
+	struct kvec iov[MAX_SKB_FRAGS + 1];
+	skb_frag_t *frag;
+	int i, nr;
 	u32 opmode;
 	unsigned long flags;
 
@@ -333,13 +506,35 @@ static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 		qmih->flow_id = skb->mark;
 	}
 
+	if (skb->ip_summed == CHECKSUM_PARTIAL && skb_checksum_help(skb))
+		goto xmit_out;
+
+	/* Fragments are lowmem without NETIF_F_HIGHDMA */
+	iov[0].iov_base = skb->data;
+	iov[0].iov_len = skb_headlen(skb);
+	nr = 1;
+	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
+		frag = &skb_shinfo(skb)->frags[i];
+		iov[nr].iov_base = page_address(frag->page) +
+				   frag->page_offset;
+		iov[nr].iov_len = frag->size;
+		nr++;
+	}
+
+	/* Leave the interrupt to the kick tasklet unless a batch is full */
 	dev->trans_start = jiffies;
-	smd_ret = smd_write(ch, skb->data, skb->len);
+	smd_ret = smd_writev(ch, iov, nr, SMD_WRITE_MORE);
 	if (smd_ret != skb->len) {
-		pr_err("%s: smd_write returned error %d", __func__, smd_ret);
+		pr_err("%s: smd_writev returned error %d", __func__, smd_ret);
 		goto xmit_out;
 	}
 
+	if (atomic_inc_return(&p->tx_pending) >= RMNET_TX_BATCH) {
+		atomic_set(&p->tx_pending, 0);
+		smd_write_kick(ch);
+	} else
+		tasklet_schedule(&p->tx_kick);
+
 	if (RMNET_IS_MODE_IP(opmode) ||
 	    count_this_packet(skb->data, skb->len)) {
 		p->stats.tx_packets++;
@@ -351,7 +546,7 @@ static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 
 xmit_out:
 	/* data xmited, safe to release skb */
-	dev_kfree_skb_irq(skb);
+	rmnet_free_tx_skb(p, skb);
 	return 0;
 }
 
@@ -420,11 +615,8 @@ static void smd_net_notify(void *_dev, unsigned event)
 
 	spin_unlock(&p->lock);
 
-	if (smd_read_avail(p->ch) &&
-	    (smd_read_avail(p->ch) >= smd_cur_packet_size(p->ch))) {
-		smd_net_data_tasklet.data = (unsigned long) _dev;
-		tasklet_schedule(&smd_net_data_tasklet);
-	}
+	if (rmnet_rx_ready(p->ch))
+		napi_schedule(&p->napi);
 }
 
 static int __rmnet_open(struct net_device *dev)
@@ -433,6 +625,17 @@ static int __rmnet_open(struct net_device *dev)
 	void *pil;
 	struct rmnet_private *p = netdev_priv(dev);
 
+	if (p->loopback) {
+		if (!p->ch) {
+			r = smd_named_open_on_edge(SMD_LOOPBACK_PKT_NAME,
+						   SMD_LOOPBACK_TYPE, &p->ch,
+						   dev, smd_net_notify);
+			if (r < 0)
+				return -ENODEV;
+		}
+		return 0;
+	}
+
 	mutex_lock(&p->pil_lock);
 	if (!p->pil) {
 		pil = msm_rmnet_load_modem(dev);
@@ -472,11 +675,18 @@ static int __rmnet_close(struct net_device *dev)
 
 static int rmnet_open(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
 	int rc = 0;
 
 	pr_info("rmnet_open()\n");
 
 	rc = __rmnet_open(dev);
+	if (rc == 0) {
+		napi_enable(&p->napi);
+		/* pick up anything that arrived while the port was down */
+		if (rmnet_rx_ready(p->ch))
+			napi_schedule(&p->napi);
+	}
 
 	netif_start_queue(dev);
 
@@ -490,7 +700,12 @@ static int rmnet_stop(struct net_device *dev)
 	pr_info("rmnet_stop()\n");
 
 	netif_stop_queue(dev);
+	napi_disable(&p->napi);
 	tasklet_kill(&p->tsklt);
+	tasklet_kill(&p->tx_kick);
+	_rmnet_tx_kick((unsigned long)dev);
+	skb_queue_purge(&p->rx_recycle);
+	skb_frag_cache_drain(&p->rx_frag_cache);
 
 	/* TODO: unload modem safely,
 	   currently, this causes unnecessary unloads */
@@ -692,6 +907,7 @@ static void __init rmnet_setup(struct net_device *dev)
 
 	random_ether_addr(dev->dev_addr);
 
+	dev->features |= NETIF_F_GRO | NETIF_F_SG | NETIF_F_HW_CSUM;
 	dev->watchdog_timeo = 1000; /* 10 seconds? */
 }
 
@@ -741,10 +957,17 @@ static int __init rmnet_init(void)
 		spin_lock_init(&p->lock);
 		tasklet_init(&p->tsklt, _rmnet_resume_flow,
 				(unsigned long)dev);
+		tasklet_init(&p->tx_kick, _rmnet_tx_kick, (unsigned long)dev);
+		atomic_set(&p->tx_pending, 0);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
+		skb_queue_head_init(&p->rx_recycle);
+		p->loopback = (n == 0 && msm_rmnet_loopback);
 		wake_lock_init(&p->wake_lock, WAKE_LOCK_SUSPEND, ch_name[n]);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
 		p->wakeups_xmit = p->wakeups_rcv = 0;
+		p->rx_polls = p->rx_budget_hits = p->rx_recycled = 0;
+		p->tx_kicks = 0;
 #endif
 
 		init_completion(&p->complete);
@@ -774,6 +997,8 @@ static int __init rmnet_init(void)
 			continue;
 		if (device_create_file(d, &dev_attr_wakeups_rcv))
 			continue;
+		if (device_create_file(d, &dev_attr_napi_stats))
+			continue;
 #ifdef CONFIG_HAS_EARLYSUSPEND
 		if (device_create_file(d, &dev_attr_timeout_suspend))
 			continue;
@@ -364,6 +364,8 @@ extern uint dhd_txbound;
 extern uint dhd_rxbound;
 module_param(dhd_txbound, uint, 0);
 module_param(dhd_rxbound, uint, 0);
+extern uint dhd_adaptive_bound;
+module_param(dhd_adaptive_bound, uint, 0);
 
 /* Deferred transmits */
 extern uint dhd_deferred_tx;
@@ -1266,6 +1268,15 @@ dhd_dpc_thread(void *data)
 	/* Run until signal received */
 	while (1) {
 		if (down_interruptible(&dhd->dpc_sem) == 0) {
+			/* Fold requests queued while the last pass ran into this
+			 * one; each carried its own wake lock reference.
+			 */
+			while (down_trylock(&dhd->dpc_sem) == 0) {
+				dhd_os_wake_unlock(&dhd->pub);
+				dhd->pub.dpc_merged++;
+			}
+			dhd->pub.dpc_wakeups++;
+
 			/* Call bus dpc unless it indicated down (then clean stop) */
 			if (dhd->pub.busstate != DHD_BUS_DOWN) {
 				if (dhd_bus_dpc(dhd->pub.bus)) {
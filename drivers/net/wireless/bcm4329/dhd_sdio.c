@@ -78,6 +78,12 @@
 
 #define DHD_TXMINMAX	1	/* Max tx frames if rx still pending */
 
+#define DHD_BOUND_SCALE	4	/* Adaptive tx/rx bounds grow up to this x the base */
+#define DHD_TXMIN_SHIFT	3	/* Tx frames allowed with rx pending: queue depth / 8 */
+
+#define DHD_GLOM_HIST	16	/* Buckets of superframe depth histogram */
+#define DHD_BATCH_HIST	8	/* Log2 buckets of frames per dpc histogram */
+
 #define MEMBLOCK	2048		/* Block size used for downloading of dongle image */
 #define MAX_DATA_BUF	(32 * 1024)	/* Must be large enough to hold biggest possible glom */
 
@@ -273,6 +279,18 @@ typedef struct dhd_bus {
 	uint		f2txdata;		/* Number of f2 frame writes */
 	uint		f1regdata;		/* Number of f1 register accesses */
 
+	/* Adaptive bounds and per-stage statistics */
+	uint		rxbound_cur;		/* Current rx frames per dpc */
+	uint		txbound_cur;		/* Current tx frames per dpc */
+	uint		dpc_runs;		/* Number of dpc passes */
+	uint		dpc_rxframes;		/* Frames read by dpc passes */
+	uint		dpc_txframes;		/* Frames sent by dpc passes */
+	uint		rxbound_hits;		/* Dpc passes that used up the rx bound */
+	uint		txbound_hits;		/* Dpc passes that used up the tx bound */
+	uint		rxglom_hist[DHD_GLOM_HIST];	/* Superframes by subframe count */
+	uint		rxbatch_hist[DHD_BATCH_HIST];	/* Dpc passes by log2 rx frames */
+	uint		txbatch_hist[DHD_BATCH_HIST];	/* Dpc passes by log2 tx frames */
+
 	uint8		*ctrl_frame_buf;
 	uint32		ctrl_frame_len;
 	bool		ctrl_frame_stat;
@@ -302,6 +320,9 @@ uint dhd_txbound;
 uint dhd_rxbound;
 uint dhd_txminmax;
 
+/* Adapt tx/rx bounds to queue depth (bounds above become the minimum) */
+uint dhd_adaptive_bound = TRUE;
+
 /* override the RAM size if possible */
 #define DONGLE_MIN_MEMSIZE (128 *1024)
 int dhd_dongle_memsize;
@@ -1383,6 +1404,7 @@ enum {
 	IOV_TXBOUND,
 	IOV_RXBOUND,
 	IOV_TXMINMAX,
+	IOV_ADAPTBOUND,
 	IOV_IDLETIME,
 	IOV_IDLECLOCK,
 	IOV_SD1IDLE,
@@ -1407,6 +1429,7 @@ const bcm_iovar_t dhdsdio_iovars[] = {
 	{"alignctl",	IOV_ALIGNCTL,	0,	IOVT_BOOL,	0 },
 	{"sdalign",	IOV_SDALIGN,	0,	IOVT_BOOL,	0 },
 	{"devreset",	IOV_DEVRESET,	0,	IOVT_BOOL,	0 },
+	{"adaptbound",	IOV_ADAPTBOUND,	0,	IOVT_BOOL,	0 },
 #ifdef DHD_DEBUG
 	{"sdreg",	IOV_SDREG,	0,	IOVT_BUFFER,	sizeof(sdreg_t) },
 	{"sbreg",	IOV_SBREG,	0,	IOVT_BUFFER,	sizeof(sdreg_t) },
@@ -1444,6 +1467,7 @@ void
 dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 {
 	dhd_bus_t *bus = dhdp->bus;
+	int i;
 
 	bcm_bprintf(strbuf, "Bus SDIO structure:\n");
 	bcm_bprintf(strbuf, "hostintmask 0x%08x intstatus 0x%08x sdpcm_ver %d\n",
@@ -1482,6 +1506,10 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		             bus->dhd->rx_packets);
 		dhd_dump_pct(strbuf, ", pkts/glom", bus->rxglompkts, bus->rxglomframes);
 		bcm_bprintf(strbuf, "\n");
+		bcm_bprintf(strbuf, "Rx: glom depth hist");
+		for (i = 0; i < DHD_GLOM_HIST; i++)
+			bcm_bprintf(strbuf, " %d", bus->rxglom_hist[i]);
+		bcm_bprintf(strbuf, "\n");
 
 		dhd_dump_pct(strbuf, "Tx: pkts/f2wr", bus->dhd->tx_packets, bus->f2txdata);
 		dhd_dump_pct(strbuf, ", pkts/f1sd", bus->dhd->tx_packets, bus->f1regdata);
@@ -1503,6 +1531,26 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		bcm_bprintf(strbuf, "\n\n");
 	}
 
+	bcm_bprintf(strbuf, "dpc runs %d rxframes %d txframes %d adaptive %d\n",
+	            bus->dpc_runs, bus->dpc_rxframes, bus->dpc_txframes,
+	            dhd_adaptive_bound);
+	dhd_dump_pct(strbuf, "Dpc: rx/run", bus->dpc_rxframes, bus->dpc_runs);
+	dhd_dump_pct(strbuf, ", tx/run", bus->dpc_txframes, bus->dpc_runs);
+	dhd_dump_pct(strbuf, ", sd/frame", (bus->f2txdata + bus->f2rxhdrs +
+	             bus->f2rxdata + bus->f1regdata),
+	             (bus->dhd->tx_packets + bus->dhd->rx_packets));
+	bcm_bprintf(strbuf, "\n");
+	bcm_bprintf(strbuf, "rxbound %d (cur %d, hits %d) txbound %d (cur %d, hits %d)\n",
+	            dhd_rxbound, bus->rxbound_cur, bus->rxbound_hits,
+	            dhd_txbound, bus->txbound_cur, bus->txbound_hits);
+	bcm_bprintf(strbuf, "Rx frames/dpc log2 hist");
+	for (i = 0; i < DHD_BATCH_HIST; i++)
+		bcm_bprintf(strbuf, " %d", bus->rxbatch_hist[i]);
+	bcm_bprintf(strbuf, "\nTx frames/dpc log2 hist");
+	for (i = 0; i < DHD_BATCH_HIST; i++)
+		bcm_bprintf(strbuf, " %d", bus->txbatch_hist[i]);
+	bcm_bprintf(strbuf, "\n\n");
+
 #ifdef SDTEST
 	if (bus->pktgen_count) {
 		bcm_bprintf(strbuf, "pktgen config and count:\n");
@@ -1533,6 +1581,11 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->tx_sderrs = bus->fc_rcvd = bus->fc_xoff = bus->fc_xon = 0;
 	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = 0;
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
+	bus->dpc_runs = bus->dpc_rxframes = bus->dpc_txframes = 0;
+	bus->rxbound_hits = bus->txbound_hits = 0;
+	bzero(bus->rxglom_hist, sizeof(bus->rxglom_hist));
+	bzero(bus->rxbatch_hist, sizeof(bus->rxbatch_hist));
+	bzero(bus->txbatch_hist, sizeof(bus->txbatch_hist));
 }
 
 #ifdef SDTEST
@@ -2175,10 +2228,17 @@ dhdsdio_doiovar(dhd_bus_t *bus, const bcm_iovar_t *vi, uint32 actionid, const ch
 	case IOV_SVAL(IOV_TXMINMAX):
 		dhd_txminmax = (uint)int_val;
 		break;
+#endif /* DHD_DEBUG */
 
+	case IOV_GVAL(IOV_ADAPTBOUND):
+		int_val = (int32)dhd_adaptive_bound;
+		bcopy(&int_val, arg, val_size);
+		break;
 
+	case IOV_SVAL(IOV_ADAPTBOUND):
+		dhd_adaptive_bound = bool_val;
+		break;
 
-#endif /* DHD_DEBUG */
 
 
 #ifdef SDTEST
@@ -3242,6 +3302,7 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 
 		bus->rxglomframes++;
 		bus->rxglompkts += num;
+		bus->rxglom_hist[MIN(num, DHD_GLOM_HIST - 1)]++;
 	}
 	return num;
 }
@@ -3895,6 +3956,34 @@ dhdsdio_hostmail(dhd_bus_t *bus)
 	return intstatus;
 }
 
+/* Count val in the log2 bucket of hist */
+static void
+dhdsdio_hist_add(uint *hist, uint nbuckets, uint val)
+{
+	uint i = 0;
+
+	while ((val >>= 1) && (i < nbuckets - 1))
+		i++;
+	hist[i]++;
+}
+
+/* Double a bound that was used up with work still pending, decay it
+ * back towards the configured base once the work no longer needs it.
+ */
+static uint
+dhdsdio_adapt_bound(uint cur, uint base, uint used, bool more)
+{
+	if (!dhd_adaptive_bound || !base)
+		return base;
+
+	if (more && (used >= cur))
+		cur = MIN(cur * 2, base * DHD_BOUND_SCALE);
+	else if (used < cur / 2)
+		cur = cur / 2;
+
+	return MAX(cur, base);
+}
+
 bool
 dhdsdio_dpc(dhd_bus_t *bus)
 {
@@ -3902,14 +3991,19 @@ dhdsdio_dpc(dhd_bus_t *bus)
 	sdpcmd_regs_t *regs = bus->regs;
 	uint32 intstatus, newstatus = 0;
 	uint retries = 0;
-	uint rxlimit = dhd_rxbound; /* Rx frames to read before resched */
-	uint txlimit = dhd_txbound; /* Tx frames to send before resched */
+	uint rxlimit;			  /* Rx frames to read before resched */
+	uint txlimit;			  /* Tx frames to send before resched */
+	uint txmin;			  /* Tx frames to send if rx still pending */
 	uint framecnt = 0;		  /* Temporary counter of tx/rx frames */
 	bool rxdone = TRUE;		  /* Flag for no more read data */
 	bool resched = FALSE;	  /* Flag indicating resched wanted */
 
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 
+	rxlimit = dhd_adaptive_bound ? MAX(bus->rxbound_cur, dhd_rxbound) : dhd_rxbound;
+	txlimit = dhd_adaptive_bound ? MAX(bus->txbound_cur, dhd_txbound) : dhd_txbound;
+	bus->dpc_runs++;
+
 	/* Start with leftover status bits */
 	intstatus = bus->intstatus;
 
@@ -4036,6 +4130,12 @@ dhdsdio_dpc(dhd_bus_t *bus)
 		framecnt = dhdsdio_readframes(bus, rxlimit, &rxdone);
 		if (rxdone || bus->rxskip)
 			intstatus &= ~I_HMB_FRAME_IND;
+		if (!rxdone && (framecnt >= rxlimit))
+			bus->rxbound_hits++;
+		bus->rxbound_cur = dhdsdio_adapt_bound(rxlimit, dhd_rxbound,
+		                                       framecnt, !rxdone);
+		bus->dpc_rxframes += framecnt;
+		dhdsdio_hist_add(bus->rxbatch_hist, DHD_BATCH_HIST, framecnt);
 		rxlimit -= MIN(framecnt, rxlimit);
 	}
 
@@ -4094,8 +4194,22 @@ clkwait:
 	/* Send queued frames (limit 1 if rx may still be pending) */
 	else if ((bus->clkstate != CLK_PENDING) && !bus->fcstate &&
 	    pktq_mlen(&bus->txq, ~bus->flowcontrol) && txlimit && DATAOK(bus)) {
-		framecnt = rxdone ? txlimit : MIN(txlimit, dhd_txminmax);
+		/* A deep tx queue gets more than the minimum while rx is pending */
+		txmin = dhd_txminmax;
+		if (dhd_adaptive_bound)
+			txmin = MAX(txmin, pktq_mlen(&bus->txq, ~bus->flowcontrol) >>
+			            DHD_TXMIN_SHIFT);
+		framecnt = rxdone ? txlimit : MIN(txlimit, txmin);
 		framecnt = dhdsdio_sendfromq(bus, framecnt);
+		if (rxdone) {
+			bool more = pktq_mlen(&bus->txq, ~bus->flowcontrol) != 0;
+			if (more && (framecnt >= txlimit))
+				bus->txbound_hits++;
+			bus->txbound_cur = dhdsdio_adapt_bound(txlimit, dhd_txbound,
+			                                       framecnt, more);
+		}
+		bus->dpc_txframes += framecnt;
+		dhdsdio_hist_add(bus->txbatch_hist, DHD_BATCH_HIST, framecnt);
 		txlimit -= framecnt;
 	}
 
@@ -4664,6 +4778,8 @@ dhdsdio_probe(uint16 venid, uint16 devid, uint16 bus_no, uint16 slot,
 	bus->bus = DHD_BUS;
 	bus->tx_seq = SDPCM_SEQUENCE_WRAP - 1;
 	bus->usebufpool = FALSE; /* Use bufpool if allocated, else use locally malloced rxbuf */
+	bus->rxbound_cur = dhd_rxbound;
+	bus->txbound_cur = dhd_txbound;
 
 	/* attempt to attach to the dongle */
 	if (!(dhdsdio_probe_attach(bus, osh, sdh, regsva, devid))) {
@@ -31,6 +31,10 @@
 #include <linux/sched.h>
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
+#include <linux/ktime.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/binder.h>
 
 #include "binder.h"
 
@@ -88,6 +92,8 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 
 static int binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
+static int binder_inherit_rt;
+module_param_named(inherit_rt, binder_inherit_rt, bool, S_IWUSR | S_IRUGO);
 
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
@@ -263,6 +269,16 @@ enum binder_deferred_state {
 	BINDER_DEFERRED_RELEASE      = 0x04,
 };
 
+/*
+ * Scheduling policy and priority of a thread.  rt_priority is only
+ * meaningful for SCHED_FIFO and SCHED_RR, nice only for the others.
+ */
+struct binder_priority {
+	unsigned int sched_policy;
+	int rt_priority;
+	long nice;
+};
+
 struct binder_proc {
 	struct hlist_node proc_node;
 	struct rb_root threads;
@@ -310,6 +326,7 @@ struct binder_thread {
 	struct binder_proc *proc;
 	struct rb_node rb_node;
 	int pid;
+	struct task_struct *task;
 	int looper;
 	struct binder_transaction *transaction_stack;
 	struct list_head todo;
@@ -330,13 +347,15 @@ struct binder_transaction {
 	struct binder_thread *to_thread;
 	struct binder_transaction *to_parent;
 	unsigned need_reply:1;
+	unsigned set_priority_called:1;
 	/* unsigned is_dead:1; */	/* not used at the moment */
 
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
+	ktime_t	start_time;
 	uid_t	sender_euid;
 };
 
@@ -498,6 +517,150 @@ static void binder_set_nice(long nice)
 	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
 }
 
+static inline int binder_is_rt_policy(unsigned int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static struct binder_priority binder_get_priority(struct task_struct *task)
+{
+	struct binder_priority p;
+
+	p.sched_policy = task->policy;
+	p.rt_priority = task->rt_priority;
+	p.nice = task_nice(task);
+	return p;
+}
+
+/* Kernel-style priority: lower values run first. */
+static int binder_priority_rank(struct binder_priority p)
+{
+	if (binder_is_rt_policy(p.sched_policy))
+		return MAX_RT_PRIO - 1 - p.rt_priority;
+	return MAX_RT_PRIO + 20 + p.nice;
+}
+
+/*
+ * Switch task to the desired policy and priority.  A nice value is
+ * subject to RLIMIT_NICE when verify is set, which is only allowed for
+ * the current task; an inherited real-time priority never is, since the
+ * caller that lent it already holds it.
+ */
+static void binder_set_priority(struct task_struct *task,
+				struct binder_priority desired, int verify)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	if (binder_is_rt_policy(desired.sched_policy)) {
+		if (task->policy == desired.sched_policy &&
+		    task->rt_priority == desired.rt_priority)
+			return;
+		param.sched_priority = desired.rt_priority;
+		sched_setscheduler_nocheck(task, desired.sched_policy, &param);
+		return;
+	}
+	if (binder_is_rt_policy(task->policy))
+		sched_setscheduler_nocheck(task, desired.sched_policy, &param);
+	if (verify)
+		binder_set_nice(desired.nice);
+	else
+		set_user_nice(task, desired.nice);
+}
+
+/*
+ * Priority a synchronous transaction lends to its handler task: the
+ * caller's own.  A real-time policy is only lent when inherit_rt is set,
+ * and no higher than the handler's RLIMIT_RTPRIO allows.
+ */
+static struct binder_priority
+binder_inherited_priority(struct binder_transaction *t,
+			  struct task_struct *task)
+{
+	struct binder_priority desired = t->priority;
+	unsigned long rlim_rtprio = 0;
+	unsigned long flags;
+
+	if (!binder_is_rt_policy(desired.sched_policy))
+		return desired;
+	if (binder_inherit_rt && lock_task_sighand(task, &flags)) {
+		rlim_rtprio = task->signal->rlim[RLIMIT_RTPRIO].rlim_cur;
+		unlock_task_sighand(task, &flags);
+	}
+	if (!rlim_rtprio) {
+		desired.sched_policy = SCHED_NORMAL;
+		desired.rt_priority = 0;
+	} else if (desired.rt_priority > rlim_rtprio) {
+		binder_debug(BINDER_DEBUG_PRIORITY_CAP,
+			     "binder: %d: rt priority %d capped to %lu\n",
+			     task->pid, desired.rt_priority, rlim_rtprio);
+		desired.rt_priority = rlim_rtprio;
+	}
+	return desired;
+}
+
+/*
+ * Called by the thread that picked up transaction t for node.  A
+ * synchronous transaction runs at the caller's priority, or at the
+ * node's minimum priority if that is higher; a one-way transaction only
+ * gets the node's minimum.  The previous priority is saved in t and put
+ * back by binder_restore_priority() on reply.
+ */
+static void binder_transaction_priority(struct binder_transaction *t,
+					struct binder_node *node)
+{
+	struct binder_priority desired;
+	unsigned int old_policy = current->policy;
+	int old_prio = current->normal_prio;
+
+	t->saved_priority = binder_get_priority(current);
+	if (t->flags & TF_ONE_WAY) {
+		if (t->saved_priority.nice > node->min_priority)
+			binder_set_nice(node->min_priority);
+		return;
+	}
+	desired = binder_inherited_priority(t, current);
+	if (!binder_is_rt_policy(desired.sched_policy) &&
+	    desired.nice >= node->min_priority)
+		desired.nice = node->min_priority;
+	binder_set_priority(current, desired, 1);
+	trace_binder_priority_inherit(t->debug_id, current, old_policy,
+				      old_prio, t->start_time);
+}
+
+/*
+ * The thread that will handle synchronous transaction t is already
+ * known, typically because this is a nested call back into a thread
+ * that is blocked on one of our own transactions.  If the caller runs
+ * at a higher priority, boost the handler now instead of leaving it at
+ * its own priority until it gets around to reading the transaction.
+ */
+static void binder_transaction_boost(struct task_struct *task,
+				     struct binder_transaction *t)
+{
+	struct binder_priority desired = binder_inherited_priority(t, task);
+	unsigned int old_policy = task->policy;
+	int old_prio = task->normal_prio;
+
+	t->saved_priority = binder_get_priority(task);
+	if (binder_priority_rank(desired) >=
+	    binder_priority_rank(t->saved_priority))
+		return;
+	t->set_priority_called = 1;
+	binder_set_priority(task, desired, 0);
+	trace_binder_priority_inherit(t->debug_id, task, old_policy,
+				      old_prio, t->start_time);
+}
+
+static void binder_restore_priority(struct binder_transaction *t)
+{
+	unsigned int old_policy = current->policy;
+	int old_prio = current->normal_prio;
+
+	binder_set_priority(current, t->saved_priority, 1);
+	trace_binder_priority_restore(t->debug_id, current, old_policy,
+				      old_prio);
+}
+
 static size_t binder_buffer_size(struct binder_proc *proc,
 				 struct binder_buffer *buffer)
 {
@@ -1391,7 +1554,7 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_restore_priority(in_reply_to);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad transaction stack,"
@@ -1525,7 +1688,8 @@ static void binder_transaction(struct binder_proc *proc,
 	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
+	t->priority = binder_get_priority(current);
+	t->start_time = ktime_get();
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
 		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
 	if (t->buffer == NULL) {
@@ -1717,6 +1881,8 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 	t->work.type = BINDER_WORK_TRANSACTION;
 	list_add_tail(&t->work.entry, target_list);
+	if (!reply && !(t->flags & TF_ONE_WAY) && target_thread)
+		binder_transaction_boost(target_thread->task, t);
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
 	list_add_tail(&tcomplete->entry, &thread->todo);
 	if (target_wait)
@@ -2389,13 +2555,8 @@ retry:
 			struct binder_node *target_node = t->buffer->target_node;
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+			if (!t->set_priority_called)
+				binder_transaction_priority(t, target_node);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = NULL;
@@ -2522,6 +2683,8 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 		binder_stats_created(BINDER_STAT_THREAD);
 		thread->proc = proc;
 		thread->pid = current->pid;
+		get_task_struct(current);
+		thread->task = current;
 		init_waitqueue_head(&thread->wait);
 		INIT_LIST_HEAD(&thread->todo);
 		rb_link_node(&thread->rb_node, parent, p);
@@ -2569,6 +2732,7 @@ static int binder_free_thread(struct binder_proc *proc,
 	if (send_reply)
 		binder_send_failed_reply(send_reply, BR_DEAD_REPLY);
 	binder_release_work(&thread->todo);
+	put_task_struct(thread->task);
 	kfree(thread);
 	binder_stats_deleted(BINDER_STAT_THREAD);
 	return active_transactions;
@@ -3113,13 +3277,16 @@ static char *print_binder_transaction(char *buf, char *end, const char *prefix,
 {
 	buf += snprintf(buf, end - buf,
 			"%s %d: %p from %d:%d to %d:%d code %x "
-			"flags %x pri %ld r%d",
+			"flags %x pri %u:%ld r%d",
 			prefix, t->debug_id, t,
 			t->from ? t->from->proc->pid : 0,
 			t->from ? t->from->pid : 0,
 			t->to_proc ? t->to_proc->pid : 0,
 			t->to_thread ? t->to_thread->pid : 0,
-			t->code, t->flags, t->priority, t->need_reply);
+			t->code, t->flags, t->priority.sched_policy,
+			binder_is_rt_policy(t->priority.sched_policy) ?
+			(long)t->priority.rt_priority : t->priority.nice,
+			t->need_reply);
 	if (buf >= end)
 		return buf;
 	if (t->buffer == NULL) {
@@ -27,6 +27,7 @@
 #include <linux/mount.h>
 #include <linux/async.h>
 #include <linux/posix_acl.h>
+#include <linux/ccache.h>
 
 /*
  * This is needed for the following functions:
@@ -321,6 +322,7 @@ void clear_inode(struct inode *inode)
 	invalidate_inode_buffers(inode);
 
 	BUG_ON(inode->i_data.nrpages);
+	ccache_invalidate_inode(&inode->i_data);
 	BUG_ON(!(inode->i_state & I_FREEING));
 	BUG_ON(inode->i_state & I_CLEAR);
 	inode_sync_wait(inode);
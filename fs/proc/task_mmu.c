@@ -8,6 +8,7 @@
 #include <linux/mempolicy.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/working_set.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -550,6 +551,76 @@ const struct file_operations proc_clear_refs_operations = {
 	.write		= clear_refs_write,
 };
 
+#ifdef CONFIG_WORKING_SET_SAMPLING
+static int working_set_show_pid(struct seq_file *m, void *v)
+{
+	struct task_struct *task;
+	struct mm_struct *mm;
+
+	task = get_pid_task(m->private, PIDTYPE_PID);
+	if (!task)
+		return -ESRCH;
+	mm = get_task_mm(task);
+	put_task_struct(task);
+	if (mm) {
+		working_set_show(m, mm);
+		mmput(mm);
+	}
+	return 0;
+}
+
+static int working_set_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, working_set_show_pid, proc_pid(inode));
+}
+
+/*
+ * Writing 1 to /proc/pid/working_set starts sampling which of the pages
+ * of the process are in use, writing 0 stops it.
+ */
+static ssize_t working_set_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	char buffer[PROC_NUMBUF];
+	struct mm_struct *mm;
+	long enable;
+	int err = 0;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+	if (strict_strtol(strstrip(buffer), 10, &enable))
+		return -EINVAL;
+	if (enable < 0 || enable > 1)
+		return -EINVAL;
+	task = get_proc_task(file->f_path.dentry->d_inode);
+	if (!task)
+		return -ESRCH;
+	mm = get_task_mm(task);
+	if (mm) {
+		if (enable)
+			err = working_set_start(mm);
+		else
+			working_set_stop(mm);
+		mmput(mm);
+	}
+	put_task_struct(task);
+
+	return err ? err : count;
+}
+
+const struct file_operations proc_working_set_operations = {
+	.open		= working_set_open,
+	.read		= seq_read,
+	.write		= working_set_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif /* CONFIG_WORKING_SET_SAMPLING */
+
 struct pagemapread {
 	int pos, len;
 	u64 *buffer;
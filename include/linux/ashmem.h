@@ -51,4 +51,13 @@ int get_ashmem_file(int fd, struct file **filp, struct file **vm_file,
 			unsigned long *len);
 void put_ashmem_file(struct file *file);
 
+#ifdef CONFIG_ASHMEM
+int is_ashmem_file(struct file *file);
+#else
+static inline int is_ashmem_file(struct file *file)
+{
+	return 0;
+}
+#endif
+
 #endif	/* _LINUX_ASHMEM_H */
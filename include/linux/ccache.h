@@ -0,0 +1,67 @@
+#ifndef _LINUX_CCACHE_H
+#define _LINUX_CCACHE_H
+
+#include <linux/fs.h>
+#include <linux/mm_types.h>
+
+struct ccache_page;
+
+#ifdef CONFIG_CCACHE
+extern struct ccache_page *ccache_prepare_page(struct address_space *mapping,
+					       struct page *page);
+extern void ccache_insert_page(struct address_space *mapping,
+			       struct ccache_page *cp);
+extern void ccache_free_page(struct ccache_page *cp);
+extern int ccache_readpage(struct address_space *mapping, struct page *page,
+			   pgoff_t index);
+extern void ccache_invalidate_range(struct address_space *mapping,
+				    pgoff_t start, pgoff_t end);
+
+static inline void ccache_invalidate_page(struct address_space *mapping,
+					  pgoff_t index)
+{
+	ccache_invalidate_range(mapping, index, index);
+}
+
+static inline void ccache_invalidate_inode(struct address_space *mapping)
+{
+	ccache_invalidate_range(mapping, 0, ~0UL);
+}
+#else
+static inline struct ccache_page *
+ccache_prepare_page(struct address_space *mapping, struct page *page)
+{
+	return NULL;
+}
+
+static inline void ccache_insert_page(struct address_space *mapping,
+				      struct ccache_page *cp)
+{
+}
+
+static inline void ccache_free_page(struct ccache_page *cp)
+{
+}
+
+static inline int ccache_readpage(struct address_space *mapping,
+				  struct page *page, pgoff_t index)
+{
+	return 0;
+}
+
+static inline void ccache_invalidate_range(struct address_space *mapping,
+					   pgoff_t start, pgoff_t end)
+{
+}
+
+static inline void ccache_invalidate_page(struct address_space *mapping,
+					  pgoff_t index)
+{
+}
+
+static inline void ccache_invalidate_inode(struct address_space *mapping)
+{
+}
+#endif /* CONFIG_CCACHE */
+
+#endif /* _LINUX_CCACHE_H */
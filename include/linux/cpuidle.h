@@ -186,6 +186,12 @@ static inline void cpuidle_unregister_governor(struct cpuidle_governor *gov) { }
 
 #endif
 
+#ifdef CONFIG_CPU_IDLE_GOV_PREDICT
+extern void cpuidle_predict_irq(unsigned int irq);
+#else
+static inline void cpuidle_predict_irq(unsigned int irq) { }
+#endif
+
 #ifdef CONFIG_ARCH_HAS_CPU_RELAX
 #define CPUIDLE_DRIVER_STATE_START	1
 #else
@@ -19,6 +19,7 @@
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/list.h>
 #endif
+#include <linux/types.h>
 
 /* The early_suspend structure defines suspend and resume hooks to be called
  * when the user visible sleep state of the system changes, and a level to
@@ -40,6 +41,16 @@ enum {
 	EARLY_SUSPEND_LEVEL_DISABLE_FB = 150,
 	EARLY_SUSPEND_LEVEL_BU21018MWV_DRV,
 };
+#define EARLY_SUSPEND_HIST_BUCKETS	12
+
+/* Latencies of one handler; bucket n counts calls under 2^n ms */
+struct early_suspend_stat {
+	unsigned int count;
+	unsigned long max_us;
+	u64 total_us;
+	unsigned int hist[EARLY_SUSPEND_HIST_BUCKETS];
+};
+
 struct early_suspend {
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	struct list_head link;
@@ -47,6 +58,10 @@ struct early_suspend {
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
 #endif
+#ifdef CONFIG_EARLYSUSPEND_STAT
+	struct early_suspend_stat suspend_stat;
+	struct early_suspend_stat resume_stat;
+#endif
 };
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
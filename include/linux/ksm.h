@@ -12,14 +12,27 @@
 #include <linux/sched.h>
 #include <linux/vmstat.h>
 
+/*
+ * Areas which KSM will never merge in, whatever the advice: shared,
+ * special or huge mappings.
+ */
+#define VM_KSM_EXCLUDE	(VM_SHARED   | VM_MAYSHARE   | VM_PFNMAP  | \
+			 VM_IO       | VM_DONTEXPAND | VM_RESERVED | \
+			 VM_HUGETLB  | VM_INSERTPAGE | VM_MIXEDMAP | VM_SAO)
+
 #ifdef CONFIG_KSM
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags);
 int __ksm_enter(struct mm_struct *mm);
 void __ksm_exit(struct mm_struct *mm);
+int ksm_enable_merge_any(struct mm_struct *mm);
+int ksm_disable_merge_any(struct mm_struct *mm);
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
+	/* A zygote's opt-in is inherited by the children it forks */
+	if (test_bit(MMF_VM_MERGE_ANY, &oldmm->flags))
+		set_bit(MMF_VM_MERGE_ANY, &mm->flags);
 	if (test_bit(MMF_VM_MERGEABLE, &oldmm->flags))
 		return __ksm_enter(mm);
 	return 0;
@@ -31,6 +44,19 @@ static inline void ksm_exit(struct mm_struct *mm)
 		__ksm_exit(mm);
 }
 
+/*
+ * Once a process has opted in with prctl(PR_SET_KSM), every new private
+ * area it maps is made VM_MERGEABLE, as if madvised MADV_MERGEABLE.
+ */
+static inline unsigned long ksm_vm_flags(struct mm_struct *mm,
+					 unsigned long vm_flags)
+{
+	if (test_bit(MMF_VM_MERGE_ANY, &mm->flags) &&
+	    !(vm_flags & VM_KSM_EXCLUDE))
+		vm_flags |= VM_MERGEABLE;
+	return vm_flags;
+}
+
 /*
  * A KSM page is one of those write-protected "shared pages" or "merged pages"
  * which KSM maps into multiple mms, wherever identical anonymous page content
@@ -68,6 +94,22 @@ static inline void ksm_exit(struct mm_struct *mm)
 {
 }
 
+static inline int ksm_enable_merge_any(struct mm_struct *mm)
+{
+	return -EINVAL;
+}
+
+static inline int ksm_disable_merge_any(struct mm_struct *mm)
+{
+	return -EINVAL;
+}
+
+static inline unsigned long ksm_vm_flags(struct mm_struct *mm,
+					 unsigned long vm_flags)
+{
+	return vm_flags;
+}
+
 static inline int PageKsm(struct page *page)
 {
 	return 0;
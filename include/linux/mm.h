@@ -1190,6 +1190,18 @@ void page_cache_async_readahead(struct address_space *mapping,
 				unsigned long size);
 
 unsigned long max_sane_readahead(unsigned long nr);
+
+#ifdef CONFIG_READAHEAD_PROFILE
+void readahead_profile_miss(struct address_space *mapping,
+			    struct file_ra_state *ra, struct file *filp,
+			    pgoff_t offset, unsigned long nr);
+#else
+static inline void readahead_profile_miss(struct address_space *mapping,
+			    struct file_ra_state *ra, struct file *filp,
+			    pgoff_t offset, unsigned long nr)
+{
+}
+#endif
 unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
@@ -102,4 +102,13 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Let KSM merge identical pages in all private anonymous memory of the
+ * process, without the areas having to be madvised MADV_MERGEABLE.
+ * Inherited by children across fork, dropped on exec.  The values are
+ * kept clear of the upstream prctl numbers.
+ */
+#define PR_SET_KSM 0x4b534d53	/* "KSMS" */
+#define PR_GET_KSM 0x4b534d47	/* "KSMG" */
+
 #endif /* _LINUX_PRCTL_H */
@@ -475,6 +475,7 @@ extern int get_dumpable(struct mm_struct *mm);
 #endif
 					/* leave room for more dump flags */
 #define MMF_VM_MERGEABLE	16	/* KSM may merge identical pages */
+#define MMF_VM_MERGE_ANY	17	/* KSM may merge any private area */
 
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
@@ -831,6 +832,25 @@ enum cpu_idle_type {
 
 #define SCHED_LOAD_SCALE_FUZZ	SCHED_LOAD_SCALE
 
+#ifdef CONFIG_CPU_FREQ
+/*
+ * Utilization callbacks from the scheduler to cpufreq governors:
+ * @util out of @max is the recent fraction of time the CPU had runnable
+ * tasks.  SCHED_CPUFREQ_WAKEUP is set when the CPU has just gone from
+ * idle to busy.
+ */
+#define SCHED_CPUFREQ_WAKEUP	0x1
+
+struct update_util_data {
+	void (*func)(struct update_util_data *data, u64 time,
+		     unsigned long util, unsigned long max,
+		     unsigned int flags);
+};
+
+extern void cpufreq_set_update_util_data(int cpu,
+					 struct update_util_data *data);
+#endif
+
 #ifdef CONFIG_SMP
 #define SD_LOAD_BALANCE		0x0001	/* Do load balancing on this domain. */
 #define SD_BALANCE_NEWIDLE	0x0002	/* Balance when about to become idle */
@@ -1927,6 +1947,10 @@ static inline unsigned int get_sysctl_timer_migration(void)
 extern unsigned int sysctl_sched_rt_period;
 extern int sysctl_sched_rt_runtime;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+extern unsigned int sysctl_sched_cfs_bandwidth_slice;
+#endif
+
 int sched_rt_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
 		loff_t *ppos);
@@ -1075,6 +1075,20 @@ static inline void skb_fill_page_desc(struct sk_buff *skb, int i,
 extern void skb_add_rx_frag(struct sk_buff *skb, int i, struct page *page,
 			    int off, int size);
 
+/*
+ * A page that a driver carves receive buffers out of, so that small
+ * frames do not each pin a whole page or a large kmalloc'd head.
+ */
+struct skb_frag_cache {
+	struct page	*page;
+	unsigned int	offset;
+};
+
+extern int skb_frag_cache_alloc(struct skb_frag_cache *fc, unsigned int size,
+				gfp_t gfp_mask, struct page **page,
+				unsigned int *offset);
+extern void skb_frag_cache_drain(struct skb_frag_cache *fc);
+
 #define SKB_PAGE_ASSERT(skb) 	BUG_ON(skb_shinfo(skb)->nr_frags)
 #define SKB_FRAG_ASSERT(skb) 	BUG_ON(skb_has_frags(skb))
 #define SKB_LINEAR_ASSERT(skb)  BUG_ON(skb_is_nonlinear(skb))
@@ -1775,6 +1789,12 @@ extern int             skb_splice_bits(struct sk_buff *skb,
 						struct pipe_inode_info *pipe,
 						unsigned int len,
 						unsigned int flags);
+extern int             skb_splice_bits_nolock(struct sk_buff *skb,
+						struct sock *sk,
+						unsigned int offset,
+						struct pipe_inode_info *pipe,
+						unsigned int len,
+						unsigned int flags);
 extern void	       skb_copy_and_csum_dev(const struct sk_buff *skb, u8 *to);
 extern void	       skb_split(struct sk_buff *skb,
 				 struct sk_buff *skb1, const u32 len);
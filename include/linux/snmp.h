@@ -225,6 +225,11 @@ enum
 	LINUX_MIB_SACKSHIFTED,
 	LINUX_MIB_SACKMERGED,
 	LINUX_MIB_SACKSHIFTFALLBACK,
+	LINUX_MIB_TCPRCVCOALESCE,		/* TCPRcvCoalesce */
+	LINUX_MIB_TCPRCVCOALESCESAVED,		/* TCPRcvCoalesceSaved */
+	LINUX_MIB_TCPRCVCOLLAPSEAVOIDED,	/* TCPRcvCollapseAvoided */
+	LINUX_MIB_IPEARLYDEMUXHIT,		/* IPEarlyDemuxHit */
+	LINUX_MIB_IPEARLYDEMUXMISS,		/* IPEarlyDemuxMiss */
 	__LINUX_MIB_MAX
 };
 
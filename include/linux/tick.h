@@ -54,6 +54,7 @@ struct tick_sched {
 	unsigned long			idle_jiffies;
 	unsigned long			idle_calls;
 	unsigned long			idle_sleeps;
+	unsigned long			idle_wakeups;
 	int				idle_active;
 	ktime_t				idle_entrytime;
 	ktime_t				idle_waketime;
@@ -0,0 +1,17 @@
+#ifndef _LINUX_WORKING_SET_H
+#define _LINUX_WORKING_SET_H
+/*
+ * Per-process working set estimation, by sampling the accessed bits of
+ * the page tables of selected processes: see mm/working_set.c.
+ */
+
+struct mm_struct;
+struct seq_file;
+
+#ifdef CONFIG_WORKING_SET_SAMPLING
+int working_set_start(struct mm_struct *mm);
+void working_set_stop(struct mm_struct *mm);
+void working_set_show(struct seq_file *m, struct mm_struct *mm);
+#endif
+
+#endif /* _LINUX_WORKING_SET_H */
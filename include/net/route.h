@@ -118,6 +118,8 @@ extern int		ip_route_output_flow(struct net *, struct rtable **rp, struct flowi
 extern int		ip_route_input(struct sk_buff*, __be32 dst, __be32 src, u8 tos, struct net_device *devin);
 extern unsigned short	ip_rt_frag_needed(struct net *net, struct iphdr *iph, unsigned short new_mtu, struct net_device *dev);
 extern void		ip_rt_send_redirect(struct sk_buff *skb);
+extern void		ip_sk_rx_dst_set(struct sock *sk, struct sk_buff *skb);
+extern void		ip_sk_rx_dst_attach(struct sock *sk, struct sk_buff *skb);
 
 extern unsigned		inet_addr_type(struct net *net, __be32 addr);
 extern unsigned		inet_dev_addr_type(struct net *net, const struct net_device *dev, __be32 addr);
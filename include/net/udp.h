@@ -136,6 +136,7 @@ extern int	udp_sendmsg(struct kiocb *iocb, struct sock *sk,
 			    struct msghdr *msg, size_t len);
 extern void	udp_flush_pending_frames(struct sock *sk);
 
+extern void	udp_v4_early_demux(struct sk_buff *skb);
 extern int	udp_rcv(struct sk_buff *skb);
 extern int	udp_ioctl(struct sock *sk, int cmd, unsigned long arg);
 extern int	udp_disconnect(struct sock *sk, int flags);
@@ -0,0 +1,48 @@
+/*
+ * include/net/uid_netstat.h - per-UID, per-interface traffic counters
+ *
+ * This file is released under the GPLv2
+ */
+
+#ifndef _NET_UID_NETSTAT_H
+#define _NET_UID_NETSTAT_H
+
+#include <linux/skbuff.h>
+#include <net/dst.h>
+#include <net/sock.h>
+
+#define UID_NETSTAT_RX		0
+#define UID_NETSTAT_TX		1
+#define UID_NETSTAT_DIRS	2
+
+#ifdef CONFIG_UID_NETSTAT
+extern void uid_netstat_account(struct sock *sk, const struct sk_buff *skb,
+				int ifindex, int dir);
+
+/*
+ * skb is being handed to sk; count it against the device it arrived on.
+ * Only the index is used, skb->dev is not held by a socket's backlog.
+ */
+static inline void uid_netstat_rx(struct sock *sk, const struct sk_buff *skb)
+{
+	uid_netstat_account(sk, skb, skb->iif, UID_NETSTAT_RX);
+}
+
+/* skb was generated locally; count it against its route's device */
+static inline void uid_netstat_tx(const struct sk_buff *skb)
+{
+	if (skb->sk)
+		uid_netstat_account(skb->sk, skb, skb_dst(skb)->dev->ifindex,
+				    UID_NETSTAT_TX);
+}
+#else
+static inline void uid_netstat_rx(struct sock *sk, const struct sk_buff *skb)
+{
+}
+
+static inline void uid_netstat_tx(const struct sk_buff *skb)
+{
+}
+#endif
+
+#endif /* _NET_UID_NETSTAT_H */
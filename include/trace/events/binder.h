@@ -0,0 +1,90 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM binder
+
+#if !defined(_TRACE_BINDER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BINDER_H
+
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/tracepoint.h>
+
+/*
+ * A thread handling a synchronous transaction took on the caller's
+ * scheduling policy and priority.  latency_ns is the time from the
+ * caller issuing the transaction to the handler being boosted.
+ */
+TRACE_EVENT(binder_priority_inherit,
+
+	TP_PROTO(int debug_id, struct task_struct *task,
+		 unsigned int old_policy, int old_prio, ktime_t start),
+
+	TP_ARGS(debug_id, task, old_policy, old_prio, start),
+
+	TP_STRUCT__entry(
+		__field(	int,		debug_id	)
+		__field(	pid_t,		pid		)
+		__field(	unsigned int,	old_policy	)
+		__field(	int,		old_prio	)
+		__field(	unsigned int,	new_policy	)
+		__field(	int,		new_prio	)
+		__field(	s64,		latency_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id	= debug_id;
+		__entry->pid		= task->pid;
+		__entry->old_policy	= old_policy;
+		__entry->old_prio	= old_prio;
+		__entry->new_policy	= task->policy;
+		__entry->new_prio	= task->normal_prio;
+		__entry->latency_ns	= ktime_to_ns(ktime_sub(ktime_get(),
+								start));
+	),
+
+	TP_printk("transaction=%d pid=%d policy=%u->%u prio=%d->%d "
+		  "latency=%lld ns",
+		  __entry->debug_id, __entry->pid,
+		  __entry->old_policy, __entry->new_policy,
+		  __entry->old_prio, __entry->new_prio,
+		  (long long)__entry->latency_ns)
+);
+
+/*
+ * The handling thread replied and went back to the priority it had
+ * before the transaction.
+ */
+TRACE_EVENT(binder_priority_restore,
+
+	TP_PROTO(int debug_id, struct task_struct *task,
+		 unsigned int old_policy, int old_prio),
+
+	TP_ARGS(debug_id, task, old_policy, old_prio),
+
+	TP_STRUCT__entry(
+		__field(	int,		debug_id	)
+		__field(	pid_t,		pid		)
+		__field(	unsigned int,	old_policy	)
+		__field(	int,		old_prio	)
+		__field(	unsigned int,	new_policy	)
+		__field(	int,		new_prio	)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id	= debug_id;
+		__entry->pid		= task->pid;
+		__entry->old_policy	= old_policy;
+		__entry->old_prio	= old_prio;
+		__entry->new_policy	= task->policy;
+		__entry->new_prio	= task->normal_prio;
+	),
+
+	TP_printk("transaction=%d pid=%d policy=%u->%u prio=%d->%d",
+		  __entry->debug_id, __entry->pid,
+		  __entry->old_policy, __entry->new_policy,
+		  __entry->old_prio, __entry->new_prio)
+);
+
+#endif /* _TRACE_BINDER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
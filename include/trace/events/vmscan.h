@@ -0,0 +1,171 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM vmscan
+
+#if !defined(_TRACE_VMSCAN_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_VMSCAN_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+#include "gfpflags.h"
+
+/*
+ * Each reclaim pass has a begin and an end event, so that the latency of
+ * direct reclaim, and the part of it spent in each LRU pass and each
+ * shrinker, can be read off the event timestamps.
+ */
+TRACE_EVENT(mm_vmscan_direct_reclaim_begin,
+
+	TP_PROTO(int order, int may_writepage, gfp_t gfp_flags),
+
+	TP_ARGS(order, may_writepage, gfp_flags),
+
+	TP_STRUCT__entry(
+		__field(	int,	order		)
+		__field(	int,	may_writepage	)
+		__field(	gfp_t,	gfp_flags	)
+	),
+
+	TP_fast_assign(
+		__entry->order		= order;
+		__entry->may_writepage	= may_writepage;
+		__entry->gfp_flags	= gfp_flags;
+	),
+
+	TP_printk("order=%d may_writepage=%d gfp_flags=%s",
+		__entry->order,
+		__entry->may_writepage,
+		show_gfp_flags(__entry->gfp_flags))
+);
+
+TRACE_EVENT(mm_vmscan_direct_reclaim_end,
+
+	TP_PROTO(unsigned long nr_reclaimed),
+
+	TP_ARGS(nr_reclaimed),
+
+	TP_STRUCT__entry(
+		__field(	unsigned long,	nr_reclaimed	)
+	),
+
+	TP_fast_assign(
+		__entry->nr_reclaimed	= nr_reclaimed;
+	),
+
+	TP_printk("nr_reclaimed=%lu", __entry->nr_reclaimed)
+);
+
+TRACE_EVENT(mm_vmscan_lru_shrink_begin,
+
+	TP_PROTO(int nid, int zid, int priority, int active, int file),
+
+	TP_ARGS(nid, zid, priority, active, file),
+
+	TP_STRUCT__entry(
+		__field(	int,	nid		)
+		__field(	int,	zid		)
+		__field(	int,	priority	)
+		__field(	int,	active		)
+		__field(	int,	file		)
+	),
+
+	TP_fast_assign(
+		__entry->nid		= nid;
+		__entry->zid		= zid;
+		__entry->priority	= priority;
+		__entry->active		= active;
+		__entry->file		= file;
+	),
+
+	TP_printk("nid=%d zid=%d priority=%d lru=%s%s",
+		__entry->nid,
+		__entry->zid,
+		__entry->priority,
+		__entry->active ? "active_" : "inactive_",
+		__entry->file ? "file" : "anon")
+);
+
+TRACE_EVENT(mm_vmscan_lru_shrink_end,
+
+	TP_PROTO(unsigned long nr_scanned, unsigned long nr_taken,
+		 unsigned long nr_reclaimed, unsigned long nr_rotated,
+		 unsigned int nr_lock_holds),
+
+	TP_ARGS(nr_scanned, nr_taken, nr_reclaimed, nr_rotated, nr_lock_holds),
+
+	TP_STRUCT__entry(
+		__field(	unsigned long,	nr_scanned	)
+		__field(	unsigned long,	nr_taken	)
+		__field(	unsigned long,	nr_reclaimed	)
+		__field(	unsigned long,	nr_rotated	)
+		__field(	unsigned int,	nr_lock_holds	)
+	),
+
+	TP_fast_assign(
+		__entry->nr_scanned	= nr_scanned;
+		__entry->nr_taken	= nr_taken;
+		__entry->nr_reclaimed	= nr_reclaimed;
+		__entry->nr_rotated	= nr_rotated;
+		__entry->nr_lock_holds	= nr_lock_holds;
+	),
+
+	TP_printk("nr_scanned=%lu nr_taken=%lu nr_reclaimed=%lu nr_rotated=%lu nr_lock_holds=%u",
+		__entry->nr_scanned,
+		__entry->nr_taken,
+		__entry->nr_reclaimed,
+		__entry->nr_rotated,
+		__entry->nr_lock_holds)
+);
+
+TRACE_EVENT(mm_vmscan_shrink_slab_begin,
+
+	TP_PROTO(void *shrink, unsigned long nr_objects,
+		 unsigned long total_scan),
+
+	TP_ARGS(shrink, nr_objects, total_scan),
+
+	TP_STRUCT__entry(
+		__field(	void *,		shrink		)
+		__field(	unsigned long,	nr_objects	)
+		__field(	unsigned long,	total_scan	)
+	),
+
+	TP_fast_assign(
+		__entry->shrink		= shrink;
+		__entry->nr_objects	= nr_objects;
+		__entry->total_scan	= total_scan;
+	),
+
+	TP_printk("%pF objects=%lu total_scan=%lu",
+		__entry->shrink,
+		__entry->nr_objects,
+		__entry->total_scan)
+);
+
+TRACE_EVENT(mm_vmscan_shrink_slab_end,
+
+	TP_PROTO(void *shrink, unsigned long nr_freed, int nr_calls),
+
+	TP_ARGS(shrink, nr_freed, nr_calls),
+
+	TP_STRUCT__entry(
+		__field(	void *,		shrink		)
+		__field(	unsigned long,	nr_freed	)
+		__field(	int,		nr_calls	)
+	),
+
+	TP_fast_assign(
+		__entry->shrink		= shrink;
+		__entry->nr_freed	= nr_freed;
+		__entry->nr_calls	= nr_calls;
+	),
+
+	TP_printk("%pF freed=%lu calls=%d",
+		__entry->shrink,
+		__entry->nr_freed,
+		__entry->nr_calls)
+);
+
+#endif /* _TRACE_VMSCAN_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
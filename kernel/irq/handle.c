@@ -20,6 +20,7 @@
 #include <linux/rculist.h>
 #include <linux/hash.h>
 #include <linux/bootmem.h>
+#include <linux/cpuidle.h>
 #include <trace/events/irq.h>
 
 #include "internals.h"
@@ -372,6 +373,10 @@ irqreturn_t handle_IRQ_event(unsigned int irq, struct irqaction *action)
 	irqreturn_t ret, retval = IRQ_NONE;
 	unsigned int status = 0;
 
+	/* the clockevent is already known to the idle governor */
+	if (!(action->flags & IRQF_TIMER))
+		cpuidle_predict_irq(irq);
+
 	if (!(action->flags & IRQF_DISABLED))
 		local_irq_enable_in_hardirq();
 
@@ -13,9 +13,13 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/seq_file.h>
 #include <linux/rtc.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
@@ -50,6 +54,10 @@ enum {
 
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* Run the handlers of one level concurrently */
+static int parallel = 1;
+module_param_named(parallel, parallel, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
 static void early_suspend(struct work_struct *work);
@@ -64,6 +72,118 @@ enum {
 };
 static int state;
 
+/* Handlers of the level being processed, run from async threads */
+static LIST_HEAD(early_suspend_domain);
+
+#ifdef CONFIG_EARLYSUSPEND_STAT
+static struct early_suspend_stat early_suspend_total;
+static struct early_suspend_stat late_resume_total;
+
+static void update_stat(struct early_suspend_stat *stat, ktime_t calltime)
+{
+	unsigned long us;
+	int bucket;
+
+	us = (unsigned long)ktime_to_us(ktime_sub(ktime_get(), calltime));
+	bucket = fls(us >> 10);
+	if (bucket >= EARLY_SUSPEND_HIST_BUCKETS)
+		bucket = EARLY_SUSPEND_HIST_BUCKETS - 1;
+
+	stat->count++;
+	stat->total_us += us;
+	if (us > stat->max_us)
+		stat->max_us = us;
+	stat->hist[bucket]++;
+}
+#endif
+
+static void call_handler(struct early_suspend *pos, int suspend)
+{
+	void (*fn)(struct early_suspend *h) =
+		suspend ? pos->suspend : pos->resume;
+#if defined(CONFIG_FIH_SUSPEND_RESUME_LOG) || defined(CONFIG_EARLYSUSPEND_STAT)
+	ktime_t calltime = ktime_get();
+#endif
+
+//Div2-SW2-BSP-EarlySuspendLog, VinceCCTsai+[
+#ifdef CONFIG_FIH_SUSPEND_RESUME_LOG
+	print_symbol(suspend ? "early suspend function: %s\n" :
+		     "late_resume function: %s\n", (unsigned long)fn);
+#endif
+//Div2-SW2-BSP-EarlySuspendLog, VinceCCTsai-]
+
+	fn(pos);
+
+#ifdef CONFIG_FIH_SUSPEND_RESUME_LOG
+	pr_info("takes %Ld usecs\n", (unsigned long long)
+		ktime_to_ns(ktime_sub(ktime_get(), calltime)) >> 10);
+#endif
+#ifdef CONFIG_EARLYSUSPEND_STAT
+	update_stat(suspend ? &pos->suspend_stat : &pos->resume_stat,
+		    calltime);
+#endif
+}
+
+static void early_suspend_async(void *data, async_cookie_t cookie)
+{
+	call_handler(data, 1);
+}
+
+static void late_resume_async(void *data, async_cookie_t cookie)
+{
+	call_handler(data, 0);
+}
+
+/* Does another handler share @pos's level? */
+static bool level_shared(struct early_suspend *pos)
+{
+	struct early_suspend *e;
+
+	if (pos->link.next != &early_suspend_handlers) {
+		e = list_entry(pos->link.next, struct early_suspend, link);
+		if (e->level == pos->level)
+			return true;
+	}
+	if (pos->link.prev != &early_suspend_handlers) {
+		e = list_entry(pos->link.prev, struct early_suspend, link);
+		if (e->level == pos->level)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Call the suspend handlers in level order, or the resume handlers in
+ * reverse level order.  Handlers that share a level are started together
+ * and all of them finish before the next level starts.  Caller must hold
+ * early_suspend_lock.
+ */
+static void call_handlers(int suspend)
+{
+	struct early_suspend *pos, *prev = NULL;
+	struct list_head *link;
+
+	for (link = suspend ? early_suspend_handlers.next :
+			      early_suspend_handlers.prev;
+	     link != &early_suspend_handlers;
+	     link = suspend ? link->next : link->prev) {
+		pos = list_entry(link, struct early_suspend, link);
+		if (prev && prev->level != pos->level)
+			async_synchronize_full_domain(&early_suspend_domain);
+		prev = pos;
+
+		if (!(suspend ? pos->suspend : pos->resume))
+			continue;
+		if (parallel && level_shared(pos))
+			async_schedule_domain(suspend ? early_suspend_async :
+					      late_resume_async, pos,
+					      &early_suspend_domain);
+		else
+			call_handler(pos, suspend);
+	}
+	async_synchronize_full_domain(&early_suspend_domain);
+}
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
@@ -98,8 +218,8 @@ extern void open_dorm_fifo(void);
 
 static void early_suspend(struct work_struct *work)
 {
-	struct early_suspend *pos;
 	unsigned long irqflags;
+	ktime_t starttime;
 	int abort = 0;
 
 //Div2-SW2-BSP-EarlySuspendLog, VinceCCTsai+[
@@ -137,26 +257,14 @@ static void early_suspend(struct work_struct *work)
 #endif
 //Div2-SW2-BSP-pmlog, HenryMCWang -
 	
-	list_for_each_entry(pos, &early_suspend_handlers, link) {
-//Div2-SW2-BSP-EarlySuspendLog, VinceCCTsai+[
-#ifdef CONFIG_FIH_SUSPEND_RESUME_LOG
-		if (pos->suspend != NULL) {
-            calltime = ktime_get();
-            print_symbol("early suspend function: %s\n", (unsigned long)pos->suspend);
-
-			pos->suspend(pos);
-
-            rettime = ktime_get();
-            delta = ktime_sub(rettime, calltime);
-            duration = (unsigned long long) ktime_to_ns(delta) >> 10;
-            pr_info("takes %Ld usecs\n", duration);
-        }
-#else
-		if (pos->suspend != NULL)
-			pos->suspend(pos);
+	starttime = ktime_get();
+	call_handlers(1);
+#ifdef CONFIG_EARLYSUSPEND_STAT
+	update_stat(&early_suspend_total, starttime);
 #endif
-//Div2-SW2-BSP-EarlySuspendLog, VinceCCTsai-]
-	}
+	if (debug_mask & DEBUG_SUSPEND)
+		pr_info("early_suspend: handlers done in %lld usecs\n",
+			ktime_to_us(ktime_sub(ktime_get(), starttime)));
 	mutex_unlock(&early_suspend_lock);
 
 //[+++] Add for fast dormancy
@@ -195,17 +303,10 @@ abort:
 
 static void late_resume(struct work_struct *work)
 {
-	struct early_suspend *pos;
 	unsigned long irqflags;
+	ktime_t starttime;
 	int abort = 0;
 
-//Div2-SW2-BSP-EarlySuspendLog, VinceCCTsai+[
-#ifdef CONFIG_FIH_SUSPEND_RESUME_LOG
-    ktime_t calltime, delta, rettime;
-    unsigned long long duration;
-#endif
-//Div2-SW2-BSP-EarlySuspendLog, VinceCCTsai-]
-
 #if defined(CONFIG_FIH_POWER_LOG) && defined(CONFIG_BATTERY_FIH_MSM)
 	struct batt_info_interface* batt_info_if = get_batt_info_if();
 #endif
@@ -225,23 +326,10 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
-//Div2-SW2-BSP-EarlySuspendLog, VinceCCTsai+[
-#ifdef CONFIG_FIH_SUSPEND_RESUME_LOG
-		if (pos->resume != NULL) {
-            calltime = ktime_get();
-            print_symbol("late_resume function: %s\n", (unsigned long)pos->resume); //Div2-SW2-BSP-EarlySuspendLog-02*
-
-			pos->resume(pos);
-
-            rettime = ktime_get();
-            delta = ktime_sub(rettime, calltime);
-            duration = (unsigned long long) ktime_to_ns(delta) >> 10;
-            pr_info("takes %Ld usecs\n", duration);
-        }
-#else
-		if (pos->resume != NULL)
-			pos->resume(pos);
+	starttime = ktime_get();
+	call_handlers(0);
+#ifdef CONFIG_EARLYSUSPEND_STAT
+	update_stat(&late_resume_total, starttime);
 #endif
 
 //Div2-SW2-BSP-pmlog, HenryMCWang +
@@ -252,7 +340,8 @@ static void late_resume(struct work_struct *work)
 	
 //Div2-SW2-BSP-EarlySuspendLog, VinceCCTsai-]
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("late_resume: done\n");
+		pr_info("late_resume: done in %lld usecs\n",
+			ktime_to_us(ktime_sub(ktime_get(), starttime)));
 //Div2-SW2-BSP-EarlySuspendLog, VinceCCTsai+[
 #ifdef __FIH_PM_STATISTICS__
 	g_pms_bkrun.time += ((g_pms_run.pre = get_seconds()) - g_pms_bkrun.pre);
@@ -317,3 +406,59 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_EARLYSUSPEND_STAT
+static void print_stat(struct seq_file *m, const char *phase, int level,
+		       void *fn, struct early_suspend_stat *stat)
+{
+	int i;
+
+	if (!stat->count)
+		return;
+	seq_printf(m, "%-8s %5d %-40pf %6u %10llu %8lu", phase, level, fn,
+		   stat->count, stat->total_us, stat->max_us);
+	for (i = 0; i < EARLY_SUSPEND_HIST_BUCKETS; i++)
+		seq_printf(m, " %u", stat->hist[i]);
+	seq_putc(m, '\n');
+}
+
+static int early_suspend_stats_show(struct seq_file *m, void *unused)
+{
+	struct early_suspend *pos;
+
+	seq_printf(m, "%-8s %5s %-40s %6s %10s %8s hist(<1ms,<2ms,...)\n",
+		   "phase", "level", "handler", "count", "total_us", "max_us");
+	mutex_lock(&early_suspend_lock);
+	print_stat(m, "suspend", -1, early_suspend, &early_suspend_total);
+	print_stat(m, "resume", -1, late_resume, &late_resume_total);
+	list_for_each_entry(pos, &early_suspend_handlers, link) {
+		print_stat(m, "suspend", pos->level, pos->suspend,
+			   &pos->suspend_stat);
+		print_stat(m, "resume", pos->level, pos->resume,
+			   &pos->resume_stat);
+	}
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, NULL);
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = early_suspend_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init early_suspend_stats_init(void)
+{
+	debugfs_create_file("early_suspend_stats", S_IRUGO, NULL, NULL,
+			    &early_suspend_stats_fops);
+	return 0;
+}
+late_initcall(early_suspend_stats_init);
+#endif
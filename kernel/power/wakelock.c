@@ -51,10 +51,25 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
 #define POLLING_DUMP_WAKELOCK_SECS	(90)	//Div251-PK-Dump_Wakelock-00+
 
+/*
+ * Each lock's flags, expiry and stats are protected by its state_lock;
+ * list_lock nests outside it and protects the list of all locks and the
+ * expiry trees.  An untimed wake_lock()/wake_unlock() only needs the
+ * lock's own state_lock and the per-type counts, so has_wake_lock() is
+ * answered from those and from the latest expiry in the tree, without
+ * walking the locks.  nr_held_locks counts every active lock of a type,
+ * timed or not, and is left alone when a held lock switches between
+ * timed and untimed, so a zero read of it alone means nothing is held.
+ */
 static DEFINE_SPINLOCK(list_lock);
-static LIST_HEAD(inactive_locks);
-static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
-static int current_event_num;
+static LIST_HEAD(all_wake_locks);
+static atomic_t nr_held_locks[WAKE_LOCK_TYPE_COUNT];
+/* active locks without a timeout */
+static atomic_t nr_active_locks[WAKE_LOCK_TYPE_COUNT];
+/* active locks with a timeout, ordered by expiry */
+static struct rb_root expire_tree[WAKE_LOCK_TYPE_COUNT];
+static struct rb_node *expire_last[WAKE_LOCK_TYPE_COUNT];
+static atomic_t current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
 suspend_state_t requested_suspend_state = PM_SUSPEND_MEM;
@@ -411,8 +426,12 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 	ret += seq_puts(m, "<< *inactive_locks >> :\n");
 	
 	//Div2-SW2-BSP-pmlog, HenryMCWang -
-	list_for_each_entry(lock, &inactive_locks, link)
-		ret = print_lock_stat(m, lock);
+	list_for_each_entry(lock, &all_wake_locks, link) {
+		spin_lock(&lock->state_lock);
+		if (!(lock->flags & WAKE_LOCK_ACTIVE))
+			ret = print_lock_stat(m, lock);
+		spin_unlock(&lock->state_lock);
+	}
 	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
 		//Div2-SW2-BSP-pmlog, HenryMCWang +
 		if(type == 0)
@@ -424,8 +443,13 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 			ret += seq_puts(m, "<< *active_wake_locks[WAKE_LOCK_IDLE] >> :\n");
 		}
 		//Div2-SW2-BSP-pmlog, HenryMCWang -
-		list_for_each_entry(lock, &active_wake_locks[type], link)
-			ret = print_lock_stat(m, lock);
+		list_for_each_entry(lock, &all_wake_locks, link) {
+			spin_lock(&lock->state_lock);
+			if ((lock->flags & WAKE_LOCK_ACTIVE) &&
+			    (lock->flags & WAKE_LOCK_TYPE_MASK) == type)
+				ret = print_lock_stat(m, lock);
+			spin_unlock(&lock->state_lock);
+		}
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 	return 0;
@@ -465,7 +489,13 @@ static void update_sleep_wait_stats_locked(int done)
 
 	now = ktime_get();
 	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
+	list_for_each_entry(lock, &all_wake_locks, link) {
+		spin_lock(&lock->state_lock);
+		if (!(lock->flags & WAKE_LOCK_ACTIVE) ||
+		    (lock->flags & WAKE_LOCK_TYPE_MASK) != WAKE_LOCK_SUSPEND) {
+			spin_unlock(&lock->state_lock);
+			continue;
+		}
 		expired = get_expired_time(lock, &etime);
 		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
 			if (expired)
@@ -479,20 +509,57 @@ static void update_sleep_wait_stats_locked(int done)
 			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
 		else
 			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
+		spin_unlock(&lock->state_lock);
 	}
 	last_sleep_time_update = now;
 }
 #endif
 
 
+/* Caller must hold list_lock and the lock's state_lock */
+static void expire_tree_insert(struct wake_lock *lock, int type)
+{
+	struct rb_node **p = &expire_tree[type].rb_node;
+	struct rb_node *parent = NULL;
+	int last = 1;
+
+	while (*p) {
+		struct wake_lock *entry;
+
+		parent = *p;
+		entry = rb_entry(parent, struct wake_lock, expire_node);
+		if ((long)(lock->expires - entry->expires) < 0) {
+			p = &parent->rb_left;
+			last = 0;
+		} else
+			p = &parent->rb_right;
+	}
+	if (last)
+		expire_last[type] = &lock->expire_node;
+
+	rb_link_node(&lock->expire_node, parent, p);
+	rb_insert_color(&lock->expire_node, &expire_tree[type]);
+}
+
+/* Caller must hold list_lock and the lock's state_lock */
+static void expire_tree_erase(struct wake_lock *lock, int type)
+{
+	if (expire_last[type] == &lock->expire_node)
+		expire_last[type] = rb_prev(&lock->expire_node);
+	rb_erase(&lock->expire_node, &expire_tree[type]);
+}
+
+/* Caller must hold list_lock */
 static void expire_wake_lock(struct wake_lock *lock)
 {
+	spin_lock(&lock->state_lock);
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
+	expire_tree_erase(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
+	atomic_dec(&nr_held_locks[lock->flags & WAKE_LOCK_TYPE_MASK]);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
+	spin_unlock(&lock->state_lock);
 	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
 		pr_info("expired wake lock %s\n", lock->name);
 }
@@ -504,7 +571,10 @@ static void print_active_locks(int type)
 	bool print_expired = true;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
+	list_for_each_entry(lock, &all_wake_locks, link) {
+		if (!(lock->flags & WAKE_LOCK_ACTIVE) ||
+		    (lock->flags & WAKE_LOCK_TYPE_MASK) != type)
+			continue;
 		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
 			long timeout = lock->expires - jiffies;
 			if (timeout > 0)
@@ -540,7 +610,10 @@ static void pmlog_active_locks(int type)
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
+	list_for_each_entry(lock, &all_wake_locks, link) {
+		if (!(lock->flags & WAKE_LOCK_ACTIVE) ||
+		    (lock->flags & WAKE_LOCK_TYPE_MASK) != type)
+			continue;
 		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
 			long timeout = lock->expires - jiffies;
 			if (timeout <= 0)
@@ -558,27 +631,45 @@ static void pmlog_active_locks(int type)
 
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct rb_node *node;
+	struct wake_lock *lock;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	if (atomic_read(&nr_active_locks[type]))
+		return -1;
+
+	/* retire the locks that have timed out, earliest first */
+	while ((node = rb_first(&expire_tree[type]))) {
+		lock = rb_entry(node, struct wake_lock, expire_node);
+		if ((long)(lock->expires - jiffies) > 0)
+			break;
+		expire_wake_lock(lock);
 	}
-	return max_timeout;
+
+	if (!expire_last[type])
+		return 0;
+	lock = rb_entry(expire_last[type], struct wake_lock, expire_node);
+	return lock->expires - jiffies;
 }
 
 long has_wake_lock(int type)
 {
 	long ret;
 	unsigned long irqflags;
+
+	/*
+	 * The idle path asks on every entry; answer from the counts when
+	 * there is nothing to retire or print. Only the held count may say
+	 * that no lock is held: a lock switching between timed and untimed
+	 * moves between the other counts but stays in that one.
+	 */
+	if (type != WAKE_LOCK_SUSPEND || !(debug_mask & DEBUG_SUSPEND)) {
+		if (!atomic_read(&nr_held_locks[type]))
+			return 0;
+		if (atomic_read(&nr_active_locks[type]))
+			return -1;
+	}
+
 	spin_lock_irqsave(&list_lock, irqflags);
 	ret = has_wake_lock_locked(type);
 	if (ret && (debug_mask & DEBUG_SUSPEND) && type == WAKE_LOCK_SUSPEND)
@@ -590,7 +681,7 @@ long has_wake_lock(int type)
 //Div251-PK-Dump_Wakelock-00+[
 #ifdef CONFIG_FIH_DUMP_WAKELOCK
 static void dump_wakelocks(unsigned long data);
-static DEFINE_TIMER(dump_wakelock_timer, dump_wakelocks, 0, 0);
+static DEFINE_DEFERRED_TIMER(dump_wakelock_timer, dump_wakelocks, 0, 0);
 
 static void dump_wakelocks(unsigned long data)
 {
@@ -628,7 +719,7 @@ static void suspend(struct work_struct *work)
 		return;
 	}
 
-	entry_event_num = current_event_num;
+	entry_event_num = atomic_read(&current_event_num);
 	sys_sync();
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("suspend: enter suspend\n");
@@ -657,7 +748,7 @@ static void suspend(struct work_struct *work)
 			tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
 			tm.tm_hour, tm.tm_min, tm.tm_sec, ts.tv_nsec);
 	}
-	if (current_event_num == entry_event_num) {
+	if (atomic_read(&current_event_num) == entry_event_num) {
 		if (debug_mask & DEBUG_SUSPEND)
 			pr_info("suspend: pm_suspend returned with no event\n");
 		wake_lock_timeout(&unknown_wakeup, HZ / 2);
@@ -727,9 +818,11 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 #endif
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
+	spin_lock_init(&lock->state_lock);
+	RB_CLEAR_NODE(&lock->expire_node);
 	INIT_LIST_HEAD(&lock->link);
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_add(&lock->link, &inactive_locks);
+	list_add(&lock->link, &all_wake_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_init);
@@ -737,10 +830,21 @@ EXPORT_SYMBOL(wake_lock_init);
 void wake_lock_destroy(struct wake_lock *lock)
 {
 	unsigned long irqflags;
+	int type;
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
-	lock->flags &= ~WAKE_LOCK_INITIALIZED;
+	spin_lock(&lock->state_lock);
+	type = lock->flags & WAKE_LOCK_TYPE_MASK;
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		expire_tree_erase(lock, type);
+	else if (lock->flags & WAKE_LOCK_ACTIVE)
+		atomic_dec(&nr_active_locks[type]);
+	if (lock->flags & WAKE_LOCK_ACTIVE)
+		atomic_dec(&nr_held_locks[type]);
+	lock->flags &= ~(WAKE_LOCK_INITIALIZED | WAKE_LOCK_ACTIVE |
+			 WAKE_LOCK_AUTO_EXPIRE);
+	spin_unlock(&lock->state_lock);
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
 		deleted_wake_locks.stat.count += lock->stat.count;
@@ -761,16 +865,89 @@ void wake_lock_destroy(struct wake_lock *lock)
 }
 EXPORT_SYMBOL(wake_lock_destroy);
 
+/*
+ * Re-evaluate the suspend wake locks after one was released and either
+ * arm the expire timer or kick off suspend. Caller must hold list_lock.
+ */
+static long update_suspend_state_locked(struct wake_lock *lock)
+{
+	long has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
+
+	if (has_lock > 0) {
+		if (debug_mask & DEBUG_EXPIRE)
+			pr_info("wake_unlock: %s, start expire timer, "
+				"%ld\n", lock->name, has_lock);
+		mod_timer(&expire_timer, jiffies + has_lock);
+	} else {
+		if (del_timer(&expire_timer))
+			if (debug_mask & DEBUG_EXPIRE)
+				pr_info("wake_unlock: %s, stop expire "
+					"timer\n", lock->name);
+		if (has_lock == 0)
+			queue_work(suspend_work_queue, &suspend_work);
+	}
+	return has_lock;
+}
+
+/*
+ * Untimed wake_lock() without list_lock. Only the lock's own state and
+ * the per-type count change, which is all has_wake_lock() looks at for
+ * untimed locks. Suspend locks take the slow path while main_wake_lock
+ * is released, since the expire timer and sleep statistics need it then.
+ */
+static int wake_lock_fast(struct wake_lock *lock, int type)
+{
+	unsigned long irqflags;
+
+	if (type == WAKE_LOCK_SUSPEND) {
+		if (!wake_lock_active(&main_wake_lock))
+			return 0;
+#ifdef CONFIG_WAKELOCK_STAT
+		if (wait_for_wakeup)
+			return 0;
+#endif
+	}
+
+	spin_lock_irqsave(&lock->state_lock, irqflags);
+	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
+		spin_unlock_irqrestore(&lock->state_lock, irqflags);
+		return 0;
+	}
+	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
+		lock->flags |= WAKE_LOCK_ACTIVE;
+		lock->expires = LONG_MAX;
+#ifdef CONFIG_WAKELOCK_STAT
+		lock->stat.last_time = ktime_get();
+#endif
+		atomic_inc(&nr_active_locks[type]);
+		atomic_inc(&nr_held_locks[type]);
+	}
+	spin_unlock_irqrestore(&lock->state_lock, irqflags);
+
+	if (type == WAKE_LOCK_SUSPEND)
+		atomic_inc(&current_event_num);
+	if (debug_mask & DEBUG_WAKE_LOCK)
+		pr_info("wake_lock: %s, type %d\n", lock->name, type);
+	return 1;
+}
+
 static void wake_lock_internal(
 	struct wake_lock *lock, long timeout, int has_timeout)
 {
 	int type;
+	int was_untimed;
 	unsigned long irqflags;
 	long expire_in;
 
-	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
+	if (!has_timeout && lock != &main_wake_lock &&
+	    wake_lock_fast(lock, type))
+		return;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	spin_lock(&lock->state_lock);
 	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
 #ifdef CONFIG_WAKELOCK_STAT
 	if (type == WAKE_LOCK_SUSPEND && wait_for_wakeup) {
@@ -785,30 +962,40 @@ static void wake_lock_internal(
 		lock->stat.last_time = ktime_get();
 	}
 #endif
+	was_untimed = (lock->flags & WAKE_LOCK_ACTIVE) &&
+		      !(lock->flags & WAKE_LOCK_AUTO_EXPIRE);
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
 		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
 		lock->stat.last_time = ktime_get();
 #endif
+		atomic_inc(&nr_held_locks[type]);
 	}
-	list_del(&lock->link);
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d, timeout %ld.%03lu\n",
 				lock->name, type, timeout / HZ,
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
+		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+			expire_tree_erase(lock, type);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		expire_tree_insert(lock, type);
+		if (was_untimed)
+			atomic_dec(&nr_active_locks[type]);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
+		if (!was_untimed)
+			atomic_inc(&nr_active_locks[type]);
+		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+			expire_tree_erase(lock, type);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
-		list_add(&lock->link, &active_wake_locks[type]);
 	}
+	spin_unlock(&lock->state_lock);
 	if (type == WAKE_LOCK_SUSPEND) {
-		current_event_num++;
+		atomic_inc(&current_event_num);
 //Div251-PK-Dump_Wakelock-00+[
 #ifdef CONFIG_FIH_DUMP_WAKELOCK
 		if (lock == &main_wake_lock) {
@@ -856,35 +1043,67 @@ void wake_lock_timeout(struct wake_lock *lock, long timeout)
 }
 EXPORT_SYMBOL(wake_lock_timeout);
 
+/*
+ * Untimed wake_unlock() without list_lock. Only the release of the last
+ * untimed suspend lock has to look at the rest of the state.
+ */
+static int wake_unlock_fast(struct wake_lock *lock, int type)
+{
+	unsigned long irqflags;
+	int last = 0;
+
+	spin_lock_irqsave(&lock->state_lock, irqflags);
+	if (lock->flags & (WAKE_LOCK_AUTO_EXPIRE |
+			   WAKE_LOCK_PREVENTING_SUSPEND)) {
+		spin_unlock_irqrestore(&lock->state_lock, irqflags);
+		return 0;
+	}
+	if (lock->flags & WAKE_LOCK_ACTIVE) {
+#ifdef CONFIG_WAKELOCK_STAT
+		wake_unlock_stat_locked(lock, 0);
+#endif
+		lock->flags &= ~WAKE_LOCK_ACTIVE;
+		atomic_dec(&nr_held_locks[type]);
+		last = atomic_dec_and_test(&nr_active_locks[type]);
+	}
+	spin_unlock_irqrestore(&lock->state_lock, irqflags);
+
+	if (debug_mask & DEBUG_WAKE_LOCK)
+		pr_info("wake_unlock: %s\n", lock->name);
+	if (last && type == WAKE_LOCK_SUSPEND) {
+		spin_lock_irqsave(&list_lock, irqflags);
+		update_suspend_state_locked(lock);
+		spin_unlock_irqrestore(&list_lock, irqflags);
+	}
+	return 1;
+}
+
 void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
+
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
+	if (lock != &main_wake_lock && wake_unlock_fast(lock, type))
+		return;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	spin_lock(&lock->state_lock);
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 0);
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		expire_tree_erase(lock, type);
+	else if (lock->flags & WAKE_LOCK_ACTIVE)
+		atomic_dec(&nr_active_locks[type]);
+	if (lock->flags & WAKE_LOCK_ACTIVE)
+		atomic_dec(&nr_held_locks[type]);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
+	spin_unlock(&lock->state_lock);
 	if (type == WAKE_LOCK_SUSPEND) {
-		long has_lock = has_wake_lock_locked(type);
-		if (has_lock > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_unlock: %s, start expire timer, "
-					"%ld\n", lock->name, has_lock);
-			mod_timer(&expire_timer, jiffies + has_lock);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_unlock: %s, stop expire "
-						"timer\n", lock->name);
-			if (has_lock == 0)
-				queue_work(suspend_work_queue, &suspend_work);
-		}
+		long has_lock = update_suspend_state_locked(lock);
 		if (lock == &main_wake_lock) {
 			if (debug_mask & DEBUG_SUSPEND)
 				print_active_locks(WAKE_LOCK_SUSPEND);
@@ -934,8 +1153,8 @@ static int __init wakelocks_init(void)
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
-		INIT_LIST_HEAD(&active_wake_locks[i]);
+	for (i = 0; i < ARRAY_SIZE(expire_tree); i++)
+		expire_tree[i] = RB_ROOT;
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
@@ -46,7 +46,9 @@
 #include <linux/stat.h>
 #include <linux/srcu.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
 #include <asm/byteorder.h>
+#include <asm/div64.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Paul E. McKenney <paulmck@us.ibm.com> and "
@@ -107,6 +109,7 @@ struct rcu_torture {
 	int rtort_pipe_count;
 	struct list_head rtort_free;
 	int rtort_mbtest;
+	ktime_t rtort_queued;
 };
 
 static LIST_HEAD(rcu_torture_freelist);
@@ -125,6 +128,13 @@ static atomic_t n_rcu_torture_free;
 static atomic_t n_rcu_torture_mberror;
 static atomic_t n_rcu_torture_error;
 static long n_rcu_torture_timers;
+static DEFINE_SPINLOCK(rcu_torture_gp_lock);
+static unsigned long n_rcu_torture_gp;
+static unsigned long rcu_torture_gp_last;	/* usec */
+static unsigned long rcu_torture_gp_max;	/* usec */
+static u64 rcu_torture_gp_total;		/* usec */
+static long rcu_torture_cb_backlog;
+static long rcu_torture_cb_backlog_max;
 static struct list_head rcu_torture_removed;
 static cpumask_var_t shuffle_tmp_mask;
 
@@ -210,6 +220,43 @@ rcu_torture_free(struct rcu_torture *p)
 	spin_unlock_bh(&rcu_torture_lock);
 }
 
+/*
+ * Note that an element is being handed to call_rcu() or one of its
+ * friends, so that the grace-period latency and the number of callbacks
+ * in flight can be reported.
+ */
+static void
+rcu_torture_cb_queued(struct rcu_torture *p)
+{
+	unsigned long flags;
+
+	p->rtort_queued = ktime_get();
+	spin_lock_irqsave(&rcu_torture_gp_lock, flags);
+	if (++rcu_torture_cb_backlog > rcu_torture_cb_backlog_max)
+		rcu_torture_cb_backlog_max = rcu_torture_cb_backlog;
+	spin_unlock_irqrestore(&rcu_torture_gp_lock, flags);
+}
+
+/*
+ * Account the time from call_rcu() to invocation of the callback.
+ */
+static void
+rcu_torture_cb_invoked(struct rcu_torture *p)
+{
+	unsigned long flags;
+	unsigned long usecs;
+
+	usecs = ktime_to_us(ktime_sub(ktime_get(), p->rtort_queued));
+	spin_lock_irqsave(&rcu_torture_gp_lock, flags);
+	rcu_torture_cb_backlog--;
+	rcu_torture_gp_last = usecs;
+	if (usecs > rcu_torture_gp_max)
+		rcu_torture_gp_max = usecs;
+	rcu_torture_gp_total += usecs;
+	n_rcu_torture_gp++;
+	spin_unlock_irqrestore(&rcu_torture_gp_lock, flags);
+}
+
 struct rcu_random_state {
 	unsigned long rrs_state;
 	long rrs_count;
@@ -311,6 +358,7 @@ rcu_torture_cb(struct rcu_head *p)
 	int i;
 	struct rcu_torture *rp = container_of(p, struct rcu_torture, rtort_rcu);
 
+	rcu_torture_cb_invoked(rp);
 	if (fullstop != FULLSTOP_DONTSTOP) {
 		/* Test is ending, just drop callbacks on the floor. */
 		/* The next initialization will pick up the pieces. */
@@ -329,6 +377,7 @@ rcu_torture_cb(struct rcu_head *p)
 
 static void rcu_torture_deferred_free(struct rcu_torture *p)
 {
+	rcu_torture_cb_queued(p);
 	call_rcu(&p->rtort_rcu, rcu_torture_cb);
 }
 
@@ -410,6 +459,7 @@ static int rcu_bh_torture_completed(void)
 
 static void rcu_bh_torture_deferred_free(struct rcu_torture *p)
 {
+	rcu_torture_cb_queued(p);
 	call_rcu_bh(&p->rtort_rcu, rcu_torture_cb);
 }
 
@@ -569,6 +619,7 @@ static int sched_torture_completed(void)
 
 static void rcu_sched_torture_deferred_free(struct rcu_torture *p)
 {
+	rcu_torture_cb_queued(p);
 	call_rcu_sched(&p->rtort_rcu, rcu_torture_cb);
 }
 
@@ -816,6 +867,7 @@ rcu_torture_printk(char *page)
 	int i;
 	long pipesummary[RCU_TORTURE_PIPE_LEN + 1] = { 0 };
 	long batchsummary[RCU_TORTURE_PIPE_LEN + 1] = { 0 };
+	u64 gp_avg;
 
 	for_each_possible_cpu(cpu) {
 		for (i = 0; i < RCU_TORTURE_PIPE_LEN + 1; i++) {
@@ -860,7 +912,16 @@ rcu_torture_printk(char *page)
 		cnt += sprintf(&page[cnt], " %d",
 			       atomic_read(&rcu_torture_wcount[i]));
 	}
-	cnt += sprintf(&page[cnt], "\n");
+	cnt += sprintf(&page[cnt], "\n%s%s ", torture_type, TORTURE_FLAG);
+	gp_avg = rcu_torture_gp_total;
+	if (n_rcu_torture_gp)
+		do_div(gp_avg, n_rcu_torture_gp);
+	cnt += sprintf(&page[cnt],
+		       "GP latency (us): last: %lu avg: %llu max: %lu n: %lu "
+		       "CB backlog: %ld max: %ld\n",
+		       rcu_torture_gp_last, (unsigned long long)gp_avg,
+		       rcu_torture_gp_max, n_rcu_torture_gp,
+		       rcu_torture_cb_backlog, rcu_torture_cb_backlog_max);
 	if (cur_ops->stats)
 		cnt += cur_ops->stats(&page[cnt]);
 	return cnt;
@@ -1143,6 +1204,12 @@ rcu_torture_init(void)
 	atomic_set(&n_rcu_torture_free, 0);
 	atomic_set(&n_rcu_torture_mberror, 0);
 	atomic_set(&n_rcu_torture_error, 0);
+	n_rcu_torture_gp = 0;
+	rcu_torture_gp_last = 0;
+	rcu_torture_gp_max = 0;
+	rcu_torture_gp_total = 0;
+	rcu_torture_cb_backlog = 0;
+	rcu_torture_cb_backlog_max = 0;
 	for (i = 0; i < RCU_TORTURE_PIPE_LEN + 1; i++)
 		atomic_set(&rcu_torture_wcount[i], 0);
 	for_each_possible_cpu(cpu) {
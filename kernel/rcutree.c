@@ -46,6 +46,8 @@
 #include <linux/cpu.h>
 #include <linux/mutex.h>
 #include <linux/time.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
 
 #include "rcutree.h"
 
@@ -680,6 +682,7 @@ rcu_start_gp(struct rcu_state *rsp, unsigned long flags)
 
 	/* Advance to a new grace period and initialize state. */
 	rsp->gpnum++;
+	rsp->gp_start_time = ktime_get();
 	WARN_ON_ONCE(rsp->signaled == RCU_GP_INIT);
 	rsp->signaled = RCU_GP_INIT; /* Hold off force_quiescent_state. */
 	rsp->jiffies_force_qs = jiffies + RCU_JIFFIES_TILL_FORCE_QS;
@@ -739,6 +742,22 @@ rcu_start_gp(struct rcu_state *rsp, unsigned long flags)
 	spin_unlock_irqrestore(&rsp->onofflock, flags);
 }
 
+/*
+ * Account the duration of the grace period that is just now ending.
+ * The caller must hold the root rcu_node's ->lock.
+ */
+static void rcu_gp_time_end(struct rcu_state *rsp)
+{
+	unsigned long usecs;
+
+	usecs = ktime_to_us(ktime_sub(ktime_get(), rsp->gp_start_time));
+	rsp->gp_time_last = usecs;
+	if (usecs > rsp->gp_time_max)
+		rsp->gp_time_max = usecs;
+	rsp->gp_time_total += usecs;
+	rsp->n_gp_timed++;
+}
+
 /*
  * Clean up after the prior grace period and let rcu_start_gp() start up
  * the next grace period if one is needed.  Note that the caller must
@@ -748,6 +767,7 @@ static void cpu_quiet_msk_finish(struct rcu_state *rsp, unsigned long flags)
 	__releases(rcu_get_root(rsp)->lock)
 {
 	WARN_ON_ONCE(!rcu_gp_in_progress(rsp));
+	rcu_gp_time_end(rsp);
 	rsp->completed = rsp->gpnum;
 	rsp->signaled = RCU_GP_IDLE;
 	rcu_start_gp(rsp, flags);  /* releases root node's rnp->lock. */
@@ -1010,9 +1030,208 @@ static void rcu_offline_cpu(int cpu)
 
 #endif /* #else #ifdef CONFIG_HOTPLUG_CPU */
 
+#ifdef CONFIG_RCU_CB_OFFLOAD
+
+static int cb_offload = 1;	/* Invoke callbacks from rcuc kthreads. */
+module_param(cb_offload, int, 0);
+
+DEFINE_PER_CPU(struct rcu_cb_kthread, rcu_cb_kthread);
+static int rcu_cb_kthreads_ready;	/* Set once kthreads can be spawned. */
+
+/*
+ * Hand a NULL-terminated list of callbacks whose grace period has ended
+ * to the current CPU's rcuc kthread.  Returns the number of callbacks
+ * handed off, or zero if there is no kthread yet, in which case the
+ * caller must invoke the callbacks itself.
+ */
+static long rcu_cb_offload(struct rcu_head *list, struct rcu_head **tail)
+{
+	struct rcu_cb_kthread *rck = &__get_cpu_var(rcu_cb_kthread);
+	struct rcu_head *rhp;
+	unsigned long flags;
+	long count = 0;
+
+	if (rck->task == NULL)
+		return 0;
+	for (rhp = list; rhp != NULL; rhp = rhp->next)
+		count++;
+	spin_lock_irqsave(&rck->lock, flags);
+	*rck->tail = list;
+	rck->tail = tail;
+	rck->qlen += count;
+	if (rck->qlen > rck->qlen_max)
+		rck->qlen_max = rck->qlen;
+	rck->n_queued += count;
+	spin_unlock_irqrestore(&rck->lock, flags);
+	wake_up_process(rck->task);
+	return count;
+}
+
+/*
+ * Body of the per-CPU rcuc kthread.  Callbacks are invoked with bottom
+ * halves disabled, just as they would be from RCU_SOFTIRQ, but the
+ * kthread may reschedule between callbacks, so there is no need for
+ * the ->blimit throttling done by rcu_do_batch().
+ */
+static int rcu_cb_kthread_fn(void *arg)
+{
+	struct rcu_cb_kthread *rck = arg;
+	struct rcu_head *list, *next;
+	long count;
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irq(&rck->lock);
+		list = rck->list;
+		rck->list = NULL;
+		rck->tail = &rck->list;
+		spin_unlock_irq(&rck->lock);
+		if (list == NULL) {
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		for (count = 0; list != NULL; count++) {
+			next = list->next;
+			prefetch(next);
+			local_bh_disable();
+			list->func(list);
+			local_bh_enable();
+			list = next;
+			cond_resched();
+		}
+
+		spin_lock_irq(&rck->lock);
+		rck->qlen -= count;
+		rck->n_invoked += count;
+		spin_unlock_irq(&rck->lock);
+		smp_mb(); /* ->n_invoked update before checking for waiters. */
+		if (waitqueue_active(&rck->drain_wq))
+			wake_up_all(&rck->drain_wq);
+	}
+	return 0;
+}
+
+/*
+ * Spawn the rcuc kthread for the specified CPU unless it already exists.
+ * The kthread is affined to its CPU by rcu_cb_kthread_affine() but is
+ * not bound to it, so that it may be moved elsewhere, for example to keep
+ * callback invocation off of CPUs that should stay in dyntick-idle mode.
+ */
+static void __cpuinit rcu_cb_kthread_spawn(int cpu)
+{
+	struct rcu_cb_kthread *rck = &per_cpu(rcu_cb_kthread, cpu);
+	struct task_struct *t;
+
+	if (!cb_offload || !rcu_cb_kthreads_ready || rck->task != NULL)
+		return;
+	t = kthread_create(rcu_cb_kthread_fn, rck, "rcuc/%d", cpu);
+	if (IS_ERR(t)) {
+		printk(KERN_ERR "RCU: unable to spawn rcuc/%d, callbacks "
+				"will be invoked from softirq\n", cpu);
+		return;
+	}
+	wake_up_process(t);
+	rck->task = t;
+}
+
+/*
+ * Move a freshly onlined CPU's rcuc kthread back to that CPU.  Any
+ * affinity set from user space does not survive CPU hotplug.
+ */
+static void __cpuinit rcu_cb_kthread_affine(int cpu)
+{
+	struct task_struct *t = per_cpu(rcu_cb_kthread, cpu).task;
+
+	if (t != NULL)
+		set_cpus_allowed_ptr(t, cpumask_of(cpu));
+}
+
+/*
+ * Wait for the rcuc kthreads to invoke all callbacks handed to them so
+ * far.  A CPU's own rcuc kthread keeps callbacks in order, but callbacks
+ * left behind by a CPU that has since gone offline are invoked without
+ * regard to rcu_barrier()'s callbacks, so they must be waited for here.
+ */
+static void rcu_cb_offload_barrier(void)
+{
+	struct rcu_cb_kthread *rck;
+	unsigned long snap;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rck = &per_cpu(rcu_cb_kthread, cpu);
+		if (rck->task == NULL)
+			continue;
+		spin_lock_irq(&rck->lock);
+		snap = rck->n_queued;
+		spin_unlock_irq(&rck->lock);
+		wait_event(rck->drain_wq,
+			   (long)(ACCESS_ONCE(rck->n_invoked) - snap) >= 0);
+	}
+}
+
+static void __init rcu_cb_offload_init(void)
+{
+	struct rcu_cb_kthread *rck;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rck = &per_cpu(rcu_cb_kthread, cpu);
+		spin_lock_init(&rck->lock);
+		rck->tail = &rck->list;
+		init_waitqueue_head(&rck->drain_wq);
+	}
+}
+
+/*
+ * Kthreads cannot be created from __rcu_init(), which runs long before
+ * kthreadd, so spawn the kthreads for the CPUs that are already online
+ * here.  Later CPUs get theirs from rcu_cpu_notify().
+ */
+static int __init rcu_cb_kthreads_init(void)
+{
+	int cpu;
+
+	rcu_cb_kthreads_ready = 1;
+	for_each_online_cpu(cpu) {
+		rcu_cb_kthread_spawn(cpu);
+		rcu_cb_kthread_affine(cpu);
+	}
+	return 0;
+}
+early_initcall(rcu_cb_kthreads_init);
+
+#else /* #ifdef CONFIG_RCU_CB_OFFLOAD */
+
+static long rcu_cb_offload(struct rcu_head *list, struct rcu_head **tail)
+{
+	return 0;
+}
+
+static void rcu_cb_kthread_spawn(int cpu)
+{
+}
+
+static void rcu_cb_kthread_affine(int cpu)
+{
+}
+
+static void rcu_cb_offload_barrier(void)
+{
+}
+
+static void __init rcu_cb_offload_init(void)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_CB_OFFLOAD */
+
 /*
  * Invoke any RCU callbacks that have made it to the end of their grace
- * period.  Thottle as specified by rdp->blimit.
+ * period, or hand them to the rcuc kthread if callbacks are offloaded.
+ * Thottle as specified by rdp->blimit.
  */
 static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 {
@@ -1038,8 +1257,10 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 			rdp->nxttail[count] = &rdp->nxtlist;
 	local_irq_restore(flags);
 
-	/* Invoke callbacks. */
-	count = 0;
+	/* Invoke callbacks, unless the rcuc kthread will do so. */
+	count = rcu_cb_offload(list, tail);
+	if (count)
+		list = NULL;
 	while (list) {
 		next = list->next;
 		prefetch(next);
@@ -1377,6 +1598,8 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 		rdp->qlen_last_fqs_check = rdp->qlen;
 	} else if ((long)(ACCESS_ONCE(rsp->jiffies_force_qs) - jiffies) < 0)
 		force_quiescent_state(rsp, 1);
+	if (rdp->qlen > rdp->qlen_max)
+		rdp->qlen_max = rdp->qlen;
 	local_irq_restore(flags);
 }
 
@@ -1469,10 +1692,9 @@ static int rcu_pending(int cpu)
 /*
  * Check to see if any future RCU-related work will need to be done
  * by the current CPU, even if none need be done immediately, returning
- * 1 if so.  This function is part of the RCU implementation; it is -not-
- * an exported member of the RCU API.
+ * 1 if so.
  */
-int rcu_needs_cpu(int cpu)
+static int rcu_needs_cpu_quick_check(int cpu)
 {
 	/* RCU callbacks either ready or pending? */
 	return per_cpu(rcu_sched_data, cpu).nxtlist ||
@@ -1480,6 +1702,82 @@ int rcu_needs_cpu(int cpu)
 	       rcu_preempt_needs_cpu(cpu);
 }
 
+#ifndef CONFIG_RCU_FAST_NO_HZ
+
+/*
+ * Check to see if any future RCU-related work will need to be done
+ * by the current CPU, even if none need be done immediately, returning
+ * 1 if so.  This function is part of the RCU implementation; it is -not-
+ * an exported member of the RCU API.
+ */
+int rcu_needs_cpu(int cpu)
+{
+	return rcu_needs_cpu_quick_check(cpu);
+}
+
+#else /* #ifndef CONFIG_RCU_FAST_NO_HZ */
+
+#define RCU_NEEDS_CPU_FLUSHES 5		/* Passes before keeping the tick. */
+static DEFINE_PER_CPU(int, rcu_dyntick_drain);
+static DEFINE_PER_CPU(unsigned long, rcu_dyntick_holdoff);
+
+/*
+ * Variant of rcu_needs_cpu() that tries to push this CPU's callbacks
+ * through their grace periods when the CPU is about to enter dyntick-idle
+ * mode.  If every other CPU is already dyntick-idle, this CPU is the only
+ * one that can hold up the grace period, and it is now in a quiescent
+ * state, so report that state and rerun RCU core processing, up to
+ * RCU_NEEDS_CPU_FLUSHES times.  If callbacks remain after that, give up
+ * for the rest of this jiffy and let the tick handle them as usual.
+ *
+ * Called with irqs disabled from tick_nohz_stop_sched_tick().
+ */
+int rcu_needs_cpu(int cpu)
+{
+	int c = 0;
+	int thatcpu;
+
+	/* Still in the holdoff period from the last failed attempt? */
+	if (per_cpu(rcu_dyntick_holdoff, cpu) == jiffies)
+		return rcu_needs_cpu_quick_check(cpu);
+
+	/* Don't bother unless we are the last non-dyntick-idle CPU. */
+	for_each_online_cpu(thatcpu)
+		if (thatcpu != cpu &&
+		    !cpumask_test_cpu(thatcpu, nohz_cpu_mask)) {
+			per_cpu(rcu_dyntick_drain, cpu) = 0;
+			per_cpu(rcu_dyntick_holdoff, cpu) = jiffies - 1;
+			return rcu_needs_cpu_quick_check(cpu);
+		}
+
+	/* Count down the passes, giving up when they are exhausted. */
+	if (per_cpu(rcu_dyntick_drain, cpu) <= 0) {
+		per_cpu(rcu_dyntick_drain, cpu) = RCU_NEEDS_CPU_FLUSHES;
+	} else if (--per_cpu(rcu_dyntick_drain, cpu) <= 0) {
+		per_cpu(rcu_dyntick_holdoff, cpu) = jiffies;
+		return rcu_needs_cpu_quick_check(cpu);
+	}
+
+	/* Report the idle quiescent state and push the grace periods. */
+	if (per_cpu(rcu_sched_data, cpu).nxtlist) {
+		rcu_sched_qs(cpu);
+		force_quiescent_state(&rcu_sched_state, 0);
+		c = c || per_cpu(rcu_sched_data, cpu).nxtlist;
+	}
+	if (per_cpu(rcu_bh_data, cpu).nxtlist) {
+		rcu_bh_qs(cpu);
+		force_quiescent_state(&rcu_bh_state, 0);
+		c = c || per_cpu(rcu_bh_data, cpu).nxtlist;
+	}
+
+	/* Let RCU_SOFTIRQ finish the job, keeping the tick until it has. */
+	if (c)
+		raise_softirq(RCU_SOFTIRQ);
+	return c || rcu_preempt_needs_cpu(cpu);
+}
+
+#endif /* #else #ifndef CONFIG_RCU_FAST_NO_HZ */
+
 static DEFINE_PER_CPU(struct rcu_head, rcu_barrier_head) = {NULL};
 static atomic_t rcu_barrier_cpu_count;
 static DEFINE_MUTEX(rcu_barrier_mutex);
@@ -1535,6 +1833,7 @@ static void _rcu_barrier(struct rcu_state *rsp,
 	if (atomic_dec_and_test(&rcu_barrier_cpu_count))
 		complete(&rcu_barrier_completion);
 	wait_for_completion(&rcu_barrier_completion);
+	rcu_cb_offload_barrier();
 	mutex_unlock(&rcu_barrier_mutex);
 }
 
@@ -1653,6 +1952,11 @@ int __cpuinit rcu_cpu_notify(struct notifier_block *self,
 	case CPU_UP_PREPARE:
 	case CPU_UP_PREPARE_FROZEN:
 		rcu_online_cpu(cpu);
+		rcu_cb_kthread_spawn(cpu);
+		break;
+	case CPU_ONLINE:
+	case CPU_ONLINE_FROZEN:
+		rcu_cb_kthread_affine(cpu);
 		break;
 	case CPU_DYING:
 	case CPU_DYING_FROZEN:
@@ -1791,6 +2095,7 @@ void __init __rcu_init(void)
 	RCU_INIT_FLAVOR(&rcu_sched_state, rcu_sched_data);
 	RCU_INIT_FLAVOR(&rcu_bh_state, rcu_bh_data);
 	__rcu_init_preempt();
+	rcu_cb_offload_init();
 	open_softirq(RCU_SOFTIRQ, rcu_process_callbacks);
 }
 
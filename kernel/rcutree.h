@@ -27,6 +27,8 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS and CONFIG_RCU_FANOUT.
@@ -170,6 +172,7 @@ struct rcu_data {
 	struct rcu_head *nxtlist;
 	struct rcu_head **nxttail[RCU_NEXT_SIZE];
 	long		qlen;		/* # of queued callbacks */
+	long		qlen_max;	/* High-water mark of ->qlen. */
 	long		qlen_last_fqs_check;
 					/* qlen at last check for QS forcing */
 	unsigned long	n_force_qs_snap;
@@ -280,7 +283,33 @@ struct rcu_state {
 #endif /* #ifdef CONFIG_RCU_CPU_STALL_DETECTOR */
 	long dynticks_completed;		/* Value of completed @ snap. */
 						/*  Protected by fqslock. */
+
+	/* Grace-period latency, guarded by the root rcu_node's lock. */
+	ktime_t gp_start_time;			/* Time current GP started. */
+	unsigned long n_gp_timed;		/* # of GPs timed. */
+	unsigned long gp_time_last;		/* Duration of last GP, usec. */
+	unsigned long gp_time_max;		/* Longest GP, usec. */
+	u64 gp_time_total;			/* Sum of GP durations, usec. */
+};
+
+#ifdef CONFIG_RCU_CB_OFFLOAD
+/*
+ * Callbacks whose grace period has ended are moved by RCU_SOFTIRQ onto
+ * this per-CPU list and invoked by the CPU's "rcuc" kthread, which may
+ * be affined away from the CPU that queued them.
+ */
+struct rcu_cb_kthread {
+	spinlock_t lock;		/* Protects the fields below. */
+	struct rcu_head *list;		/* Callbacks awaiting invocation. */
+	struct rcu_head **tail;		/* And tail pointer. */
+	long qlen;			/* # of callbacks on ->list. */
+	long qlen_max;			/* High-water mark of ->qlen. */
+	unsigned long n_queued;		/* Callbacks handed to the kthread. */
+	unsigned long n_invoked;	/* Callbacks invoked by the kthread. */
+	wait_queue_head_t drain_wq;	/* rcu_barrier() waits here. */
+	struct task_struct *task;
 };
+#endif /* #ifdef CONFIG_RCU_CB_OFFLOAD */
 
 #ifdef RCU_TREE_NONCORE
 
@@ -298,6 +327,10 @@ extern struct rcu_state rcu_preempt_state;
 DECLARE_PER_CPU(struct rcu_data, rcu_preempt_data);
 #endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
 
+#ifdef CONFIG_RCU_CB_OFFLOAD
+DECLARE_PER_CPU(struct rcu_cb_kthread, rcu_cb_kthread);
+#endif /* #ifdef CONFIG_RCU_CB_OFFLOAD */
+
 #else /* #ifdef RCU_TREE_NONCORE */
 
 /* Forward declarations for rcutree_plugin.h */
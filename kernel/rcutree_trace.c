@@ -32,6 +32,7 @@
 #include <linux/interrupt.h>
 #include <linux/sched.h>
 #include <asm/atomic.h>
+#include <asm/div64.h>
 #include <linux/bitops.h>
 #include <linux/module.h>
 #include <linux/completion.h>
@@ -64,7 +65,8 @@ static void print_one_rcu_data(struct seq_file *m, struct rcu_data *rdp)
 		   rdp->dynticks_fqs);
 #endif /* #ifdef CONFIG_NO_HZ */
 	seq_printf(m, " of=%lu ri=%lu", rdp->offline_fqs, rdp->resched_ipi);
-	seq_printf(m, " ql=%ld b=%ld\n", rdp->qlen, rdp->blimit);
+	seq_printf(m, " ql=%ld qm=%ld b=%ld\n",
+		   rdp->qlen, rdp->qlen_max, rdp->blimit);
 }
 
 #define PRINT_RCU_DATA(name, func, m) \
@@ -119,7 +121,7 @@ static void print_one_rcu_data_csv(struct seq_file *m, struct rcu_data *rdp)
 		   rdp->dynticks_fqs);
 #endif /* #ifdef CONFIG_NO_HZ */
 	seq_printf(m, ",%lu,%lu", rdp->offline_fqs, rdp->resched_ipi);
-	seq_printf(m, ",%ld,%ld\n", rdp->qlen, rdp->blimit);
+	seq_printf(m, ",%ld,%ld,%ld\n", rdp->qlen, rdp->qlen_max, rdp->blimit);
 }
 
 static int show_rcudata_csv(struct seq_file *m, void *unused)
@@ -128,7 +130,7 @@ static int show_rcudata_csv(struct seq_file *m, void *unused)
 #ifdef CONFIG_NO_HZ
 	seq_puts(m, "\"dt\",\"dt nesting\",\"dn\",\"df\",");
 #endif /* #ifdef CONFIG_NO_HZ */
-	seq_puts(m, "\"of\",\"ri\",\"ql\",\"b\"\n");
+	seq_puts(m, "\"of\",\"ri\",\"ql\",\"qm\",\"b\"\n");
 #ifdef CONFIG_TREE_PREEMPT_RCU
 	seq_puts(m, "\"rcu_preempt:\"\n");
 	PRINT_RCU_DATA(rcu_preempt_data, print_one_rcu_data_csv, m);
@@ -204,16 +206,28 @@ static const struct file_operations rcuhier_fops = {
 	.release = single_release,
 };
 
+static void print_one_rcu_gp(struct seq_file *m, struct rcu_state *rsp,
+			     const char *name)
+{
+	unsigned long n = rsp->n_gp_timed;
+	u64 avg = rsp->gp_time_total;
+
+	if (n)
+		do_div(avg, n);
+	seq_printf(m, "%s: completed=%ld  gpnum=%ld  "
+		      "gplat(us) last=%lu avg=%llu max=%lu n=%lu\n",
+		   name, rsp->completed, rsp->gpnum,
+		   rsp->gp_time_last, (unsigned long long)avg,
+		   rsp->gp_time_max, n);
+}
+
 static int show_rcugp(struct seq_file *m, void *unused)
 {
 #ifdef CONFIG_TREE_PREEMPT_RCU
-	seq_printf(m, "rcu_preempt: completed=%ld  gpnum=%ld\n",
-		   rcu_preempt_state.completed, rcu_preempt_state.gpnum);
+	print_one_rcu_gp(m, &rcu_preempt_state, "rcu_preempt");
 #endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
-	seq_printf(m, "rcu_sched: completed=%ld  gpnum=%ld\n",
-		   rcu_sched_state.completed, rcu_sched_state.gpnum);
-	seq_printf(m, "rcu_bh: completed=%ld  gpnum=%ld\n",
-		   rcu_bh_state.completed, rcu_bh_state.gpnum);
+	print_one_rcu_gp(m, &rcu_sched_state, "rcu_sched");
+	print_one_rcu_gp(m, &rcu_bh_state, "rcu_bh");
 	return 0;
 }
 
@@ -284,6 +298,40 @@ static const struct file_operations rcu_pending_fops = {
 	.release = single_release,
 };
 
+#ifdef CONFIG_RCU_CB_OFFLOAD
+
+static int show_rcucb(struct seq_file *m, void *unused)
+{
+	struct rcu_cb_kthread *rck;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rck = &per_cpu(rcu_cb_kthread, cpu);
+		if (rck->task == NULL)
+			continue;
+		seq_printf(m, "%3d%cpid=%d ql=%ld qm=%ld nq=%lu ni=%lu\n",
+			   cpu, cpu_is_offline(cpu) ? '!' : ' ',
+			   task_pid_nr(rck->task), rck->qlen, rck->qlen_max,
+			   rck->n_queued, rck->n_invoked);
+	}
+	return 0;
+}
+
+static int rcucb_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_rcucb, NULL);
+}
+
+static const struct file_operations rcucb_fops = {
+	.owner = THIS_MODULE,
+	.open = rcucb_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+#endif /* #ifdef CONFIG_RCU_CB_OFFLOAD */
+
 static struct dentry *rcudir;
 
 static int __init rcuclassic_trace_init(void)
@@ -317,6 +365,12 @@ static int __init rcuclassic_trace_init(void)
 						NULL, &rcu_pending_fops);
 	if (!retval)
 		goto free_out;
+
+#ifdef CONFIG_RCU_CB_OFFLOAD
+	retval = debugfs_create_file("rcucb", 0444, rcudir, NULL, &rcucb_fops);
+	if (!retval)
+		goto free_out;
+#endif /* #ifdef CONFIG_RCU_CB_OFFLOAD */
 	return 0;
 free_out:
 	debugfs_remove_recursive(rcudir);
@@ -227,6 +227,26 @@ static void destroy_rt_bandwidth(struct rt_bandwidth *rt_b)
 }
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+struct cfs_bandwidth {
+	/* nests inside the rq lock: */
+	spinlock_t		lock;
+	ktime_t			period;
+	u64			quota;
+	/* what is left of this period's quota, handed out in slices */
+	u64			runtime;
+	int			idle;
+	int			timer_active;
+	struct hrtimer		period_timer;
+	struct list_head	throttled_cfs_rq;
+
+	/* statistics */
+	int			nr_periods;
+	int			nr_throttled;
+	u64			throttled_time;
+};
+#endif
+
 /*
  * sched_domains_mutex serializes calls to arch_init_sched_domains,
  * detach_destroy_domains and partition_sched_domains.
@@ -259,6 +279,10 @@ struct task_group {
 	unsigned long shares;
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	struct cfs_bandwidth cfs_bandwidth;
+#endif
+
 #ifdef CONFIG_RT_GROUP_SCHED
 	struct sched_rt_entity **rt_se;
 	struct rt_rq **rt_rq;
@@ -445,6 +469,19 @@ struct cfs_rq {
 	 */
 	unsigned long rq_weight;
 #endif
+
+#ifdef CONFIG_CFS_BANDWIDTH
+	/*
+	 * runtime this cpu has drawn from tg->cfs_bandwidth and not yet
+	 * used; the group is throttled once it runs out.
+	 */
+	int runtime_enabled;
+	s64 runtime_remaining;
+
+	int throttled;
+	u64 throttled_timestamp;
+	struct list_head throttled_list;
+#endif
 #endif
 };
 
@@ -599,6 +636,16 @@ struct rq {
 	unsigned long calc_load_update;
 	long calc_load_active;
 
+#ifdef CONFIG_CPU_FREQ
+	/* utilization reported to cpufreq, see cpufreq_update_util() */
+	u64 util_stamp;
+	u64 util_window;
+	u64 util_busy;
+	unsigned long util;
+	int util_was_busy;
+	unsigned int util_flags;	/* pending from remote updates */
+#endif
+
 #ifdef CONFIG_SCHED_HRTICK
 #ifdef CONFIG_SMP
 	int hrtick_csd_pending;
@@ -1815,6 +1862,93 @@ static void cfs_rq_set_shares(struct cfs_rq *cfs_rq, unsigned long shares)
 static void calc_load_account_active(struct rq *this_rq);
 static void update_sysctl(void);
 
+#ifdef CONFIG_CPU_FREQ
+static DEFINE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
+
+/**
+ * cpufreq_set_update_util_data - set the utilization callback of a CPU
+ * @cpu: the CPU
+ * @data: the callback, or NULL to remove it
+ *
+ * @data->func is called from the scheduler on @cpu itself, with the
+ * runqueue locked and interrupts disabled, whenever a task of any class
+ * is enqueued or dequeued there, when it leaves idle and on each scheduler
+ * tick.  It must not sleep nor wake tasks up.  After removing a callback, the caller must wait with
+ * synchronize_sched() before freeing it.
+ */
+void cpufreq_set_update_util_data(int cpu, struct update_util_data *data)
+{
+	rcu_assign_pointer(per_cpu(cpufreq_update_util_data, cpu), data);
+}
+EXPORT_SYMBOL_GPL(cpufreq_set_update_util_data);
+
+/* Period over which busy time is averaged into rq->util */
+#define UTIL_WINDOW_NS	(4 * NSEC_PER_MSEC)
+
+/*
+ * Account the time since the last update as busy or idle, fold each
+ * complete window into rq->util, a running average of the fraction of
+ * time the CPU had something runnable, and pass it to the callback.
+ * Nothing is tracked for CPUs without a callback.
+ */
+static void cpufreq_update_util(struct rq *rq)
+{
+	struct update_util_data *data;
+	unsigned int flags = 0;
+	u64 now = rq->clock;
+	s64 delta;
+	int busy;
+
+	data = rcu_dereference(per_cpu(cpufreq_update_util_data, cpu_of(rq)));
+	if (!data)
+		return;
+
+	delta = now - rq->util_stamp;
+	rq->util_stamp = now;
+	if (delta > 0) {
+		rq->util_window += delta;
+		if (rq->util_was_busy)
+			rq->util_busy += delta;
+	}
+
+	if (rq->util_window >= UTIL_WINDOW_NS) {
+		u64 periods = div64_u64(rq->util_window, UTIL_WINDOW_NS);
+		unsigned long window_util;
+
+		window_util = div64_u64(rq->util_busy << SCHED_LOAD_SHIFT,
+					rq->util_window);
+		/* Each window weighs half of what came before it */
+		if (periods > BITS_PER_LONG)
+			periods = BITS_PER_LONG;
+		rq->util = ((rq->util >> (periods - 1)) + window_util) >> 1;
+		rq->util_window = 0;
+		rq->util_busy = 0;
+	}
+
+	busy = rq->cfs.nr_running || rq->rt.rt_nr_running;
+	if (busy && !rq->util_was_busy)
+		flags |= SCHED_CPUFREQ_WAKEUP;
+	rq->util_was_busy = busy;
+
+	/*
+	 * Remote wakeups are reported by the next local update, at the
+	 * latest when the woken CPU switches away from its idle task.
+	 */
+	if (cpu_of(rq) != smp_processor_id()) {
+		rq->util_flags |= flags;
+		return;
+	}
+	flags |= rq->util_flags;
+	rq->util_flags = 0;
+
+	data->func(data, now, rq->util, SCHED_LOAD_SCALE, flags);
+}
+#else
+static inline void cpufreq_update_util(struct rq *rq)
+{
+}
+#endif /* CONFIG_CPU_FREQ */
+
 #include "sched_stats.h"
 #include "sched_idletask.c"
 #include "sched_fair.c"
@@ -1872,6 +2006,7 @@ static void enqueue_task(struct rq *rq, struct task_struct *p, int wakeup)
 	sched_info_queued(p);
 	p->sched_class->enqueue_task(rq, p, wakeup);
 	p->se.on_rq = 1;
+	cpufreq_update_util(rq);
 }
 
 static void dequeue_task(struct rq *rq, struct task_struct *p, int sleep)
@@ -1890,6 +2025,7 @@ static void dequeue_task(struct rq *rq, struct task_struct *p, int sleep)
 	sched_info_dequeued(p);
 	p->sched_class->dequeue_task(rq, p, sleep);
 	p->se.on_rq = 0;
+	cpufreq_update_util(rq);
 }
 
 /*
@@ -5254,6 +5390,7 @@ void scheduler_tick(void)
 	update_rq_clock(rq);
 	update_cpu_load(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
+	cpufreq_update_util(rq);
 	spin_unlock(&rq->lock);
 
 	perf_event_task_tick(curr, cpu);
@@ -9344,6 +9481,9 @@ static void init_tg_cfs_entry(struct task_group *tg, struct cfs_rq *cfs_rq,
 	cfs_rq->tg = tg;
 	if (add)
 		list_add(&cfs_rq->leaf_cfs_rq_list, &rq->leaf_cfs_rq_list);
+#ifdef CONFIG_CFS_BANDWIDTH
+	INIT_LIST_HEAD(&cfs_rq->throttled_list);
+#endif
 
 	tg->se[cpu] = se;
 	/* se could be NULL for init_task_group */
@@ -9461,6 +9601,10 @@ void __init sched_init(void)
 	init_rt_bandwidth(&def_rt_bandwidth,
 			global_rt_period(), global_rt_runtime());
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	init_cfs_bandwidth(&init_task_group.cfs_bandwidth);
+#endif
+
 #ifdef CONFIG_RT_GROUP_SCHED
 	init_rt_bandwidth(&init_task_group.rt_bandwidth,
 			global_rt_period(), global_rt_runtime());
@@ -9786,6 +9930,8 @@ static void free_fair_sched_group(struct task_group *tg)
 {
 	int i;
 
+	destroy_cfs_bandwidth(tg_cfs_bandwidth(tg));
+
 	for_each_possible_cpu(i) {
 		if (tg->cfs_rq)
 			kfree(tg->cfs_rq[i]);
@@ -9805,6 +9951,9 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 	struct rq *rq;
 	int i;
 
+	/* before anything can fail: free_fair_sched_group() tears it down */
+	init_cfs_bandwidth(tg_cfs_bandwidth(tg));
+
 	tg->cfs_rq = kzalloc(sizeof(cfs_rq) * nr_cpu_ids, GFP_KERNEL);
 	if (!tg->cfs_rq)
 		goto err;
@@ -10435,6 +10584,100 @@ int sched_rt_handler(struct ctl_table *table, int write,
 	return ret;
 }
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static DEFINE_MUTEX(cfs_constraints_mutex);
+
+static const u64 max_cfs_quota_period = 1 * NSEC_PER_SEC;	/* 1s */
+static const u64 min_cfs_quota_period = 1 * NSEC_PER_MSEC;	/* 1ms */
+
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(tg);
+	int i, runtime_enabled;
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	/*
+	 * Tiny quotas or periods spend more time in the period timer than
+	 * they save, and long periods turn throttling into visible stalls.
+	 */
+	if (quota < min_cfs_quota_period || period < min_cfs_quota_period)
+		return -EINVAL;
+	if (period > max_cfs_quota_period)
+		return -EINVAL;
+
+	runtime_enabled = quota != RUNTIME_INF;
+
+	mutex_lock(&cfs_constraints_mutex);
+	spin_lock_irq(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(period);
+	cfs_b->quota = quota;
+	cfs_b->runtime = quota;
+	spin_unlock_irq(&cfs_b->lock);
+
+	for_each_possible_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = rq_of(cfs_rq);
+
+		spin_lock_irq(&rq->lock);
+		cfs_rq->runtime_enabled = runtime_enabled;
+		cfs_rq->runtime_remaining = 0;
+		if (cfs_rq_throttled(cfs_rq)) {
+			update_rq_clock(rq);
+			unthrottle_cfs_rq(cfs_rq);
+		}
+		spin_unlock_irq(&rq->lock);
+	}
+	mutex_unlock(&cfs_constraints_mutex);
+
+	return 0;
+}
+
+static int tg_set_cfs_quota(struct task_group *tg, long cfs_quota_us)
+{
+	u64 quota, period;
+
+	period = ktime_to_ns(tg_cfs_bandwidth(tg)->period);
+	quota = (u64)cfs_quota_us * NSEC_PER_USEC;
+	if (cfs_quota_us < 0)
+		quota = RUNTIME_INF;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static long tg_get_cfs_quota(struct task_group *tg)
+{
+	u64 quota_us;
+
+	if (tg_cfs_bandwidth(tg)->quota == RUNTIME_INF)
+		return -1;
+
+	quota_us = tg_cfs_bandwidth(tg)->quota;
+	do_div(quota_us, NSEC_PER_USEC);
+	return quota_us;
+}
+
+static int tg_set_cfs_period(struct task_group *tg, long cfs_period_us)
+{
+	u64 quota, period;
+
+	period = (u64)cfs_period_us * NSEC_PER_USEC;
+	quota = tg_cfs_bandwidth(tg)->quota;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static long tg_get_cfs_period(struct task_group *tg)
+{
+	u64 cfs_period_us;
+
+	cfs_period_us = ktime_to_ns(tg_cfs_bandwidth(tg)->period);
+	do_div(cfs_period_us, NSEC_PER_USEC);
+	return cfs_period_us;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 #ifdef CONFIG_CGROUP_SCHED
 
 /* return corresponding task_group object of a cgroup */
@@ -10546,6 +10789,42 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static s64 cpu_cfs_quota_read_s64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return tg_get_cfs_quota(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_quota_write_s64(struct cgroup *cgrp, struct cftype *cftype,
+				   s64 cfs_quota_us)
+{
+	return tg_set_cfs_quota(cgroup_tg(cgrp), cfs_quota_us);
+}
+
+static u64 cpu_cfs_period_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return tg_get_cfs_period(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_period_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				    u64 cfs_period_us)
+{
+	return tg_set_cfs_period(cgroup_tg(cgrp), cfs_period_us);
+}
+
+static int cpu_stats_show(struct cgroup *cgrp, struct cftype *cft,
+			  struct cgroup_map_cb *cb)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cgroup_tg(cgrp));
+
+	cb->fill(cb, "nr_periods", cfs_b->nr_periods);
+	cb->fill(cb, "nr_throttled", cfs_b->nr_throttled);
+	cb->fill(cb, "throttled_time", cfs_b->throttled_time);
+
+	return 0;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 #ifdef CONFIG_RT_GROUP_SCHED
 static int cpu_rt_runtime_write(struct cgroup *cgrp, struct cftype *cft,
 				s64 val)
@@ -10578,6 +10857,22 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_shares_write_u64,
 	},
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	{
+		.name = "cfs_quota_us",
+		.read_s64 = cpu_cfs_quota_read_s64,
+		.write_s64 = cpu_cfs_quota_write_s64,
+	},
+	{
+		.name = "cfs_period_us",
+		.read_u64 = cpu_cfs_period_read_u64,
+		.write_u64 = cpu_cfs_period_write_u64,
+	},
+	{
+		.name = "stat",
+		.read_map = cpu_stats_show,
+	},
+#endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
 		.name = "rt_runtime_us",
@@ -42,6 +42,8 @@ dequeue_task_idle(struct rq *rq, struct task_struct *p, int sleep)
 
 static void put_prev_task_idle(struct rq *rq, struct task_struct *prev)
 {
+	/* deliver a wakeup that was flagged by a remote enqueue */
+	cpufreq_update_util(rq);
 }
 
 #ifdef CONFIG_SMP
@@ -311,6 +311,7 @@ static void tick_nohz_stop_idle(int cpu)
 		ts->idle_lastupdate = now;
 		ts->idle_sleeptime = ktime_add(ts->idle_sleeptime, delta);
 		ts->idle_active = 0;
+		ts->idle_wakeups++;
 
 		sched_clock_idle_wakeup_event(0);
 	}
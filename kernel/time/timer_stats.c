@@ -31,6 +31,9 @@
  * Display the information collected so far:
  * # cat /proc/timer_stats
  *
+ * Display the timers that woke an idle cpu, with their rate:
+ * # cat /proc/timer_wakeups
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
@@ -42,6 +45,7 @@
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/kallsyms.h>
+#include <linux/tick.h>
 
 #include <asm/uaccess.h>
 
@@ -70,6 +74,11 @@ struct entry {
 	unsigned long		count;
 	unsigned int		timer_flag;
 
+	/*
+	 * Number of those events that woke the cpu from idle:
+	 */
+	unsigned long		wakeups;
+
 	/*
 	 * We save the command-line string to preserve
 	 * this information past task exit:
@@ -135,6 +144,39 @@ static atomic_t overflow_count;
 
 static struct entry *tstat_hash_table[TSTAT_HASH_SIZE] __read_mostly;
 
+#ifdef CONFIG_NO_HZ
+/*
+ * ts->idle_wakeups as of the last expiry charged with a wakeup:
+ */
+static DEFINE_PER_CPU(unsigned long, tstat_idle_wakeups);
+
+/*
+ * The first timer to expire after the cpu leaves idle is charged with
+ * the wakeup. The tick's own hrtimer is not: with the tick stopped it
+ * only carries the expiry of timer wheel timers, which get the charge.
+ * Must be called with irqs off.
+ */
+static int tstat_woke_cpu(void *timer)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = tick_get_tick_sched(cpu);
+	unsigned long *seen = &per_cpu(tstat_idle_wakeups, cpu);
+
+	if (timer == &ts->sched_timer || !idle_cpu(cpu))
+		return 0;
+	if (*seen == ts->idle_wakeups)
+		return 0;
+
+	*seen = ts->idle_wakeups;
+	return 1;
+}
+#else
+static inline int tstat_woke_cpu(void *timer)
+{
+	return 0;
+}
+#endif
+
 static void reset_entries(void)
 {
 	nr_entries = 0;
@@ -204,6 +246,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
 	if (curr) {
 		*curr = *entry;
 		curr->count = 0;
+		curr->wakeups = 0;
 		curr->next = NULL;
 		memcpy(curr->comm, comm, TASK_COMM_LEN);
 
@@ -258,9 +301,11 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 		goto out_unlock;
 
 	entry = tstat_lookup(&input, comm);
-	if (likely(entry))
+	if (likely(entry)) {
 		entry->count++;
-	else
+		if (tstat_woke_cpu(timer))
+			entry->wakeups++;
+	} else
 		atomic_inc(&overflow_count);
 
  out_unlock:
@@ -338,6 +383,62 @@ static int tstats_show(struct seq_file *m, void *v)
 	return 0;
 }
 
+/*
+ * Same sample as tstats_show(), restricted to the timers that woke an
+ * idle cpu. Collection is switched on and off through /proc/timer_stats.
+ */
+static int twakeups_show(struct seq_file *m, void *v)
+{
+	struct timespec period;
+	struct entry *entry;
+	unsigned long ms;
+	long wakeups = 0;
+	ktime_t time;
+	int i;
+
+	mutex_lock(&show_mutex);
+	if (timer_stats_active)
+		time_stop = ktime_get();
+
+	time = ktime_sub(time_stop, time_start);
+
+	period = ktime_to_timespec(time);
+	ms = period.tv_nsec / 1000000;
+	ms += period.tv_sec * 1000;
+	if (!ms)
+		ms = 1;
+
+	seq_puts(m, "Timer Wakeups Version: v0.1\n");
+	seq_printf(m, "Sample period: %ld.%03ld s\n", period.tv_sec,
+		   period.tv_nsec / 1000000);
+
+	for (i = 0; i < nr_entries; i++) {
+		entry = entries + i;
+		if (!entry->wakeups)
+			continue;
+
+		seq_printf(m, " %4lu, %4lu.%03lu/s, %5d %-16s ",
+			   entry->wakeups, entry->wakeups * 1000 / ms,
+			   (entry->wakeups * 1000000 / ms) % 1000,
+			   entry->pid, entry->comm);
+
+		print_name_offset(m, (unsigned long)entry->start_func);
+		seq_puts(m, " (");
+		print_name_offset(m, (unsigned long)entry->expire_func);
+		seq_puts(m, ")\n");
+
+		wakeups += entry->wakeups;
+	}
+
+	seq_printf(m, "%ld total wakeups, %ld.%03ld wakeups/sec\n",
+		   wakeups, wakeups * 1000 / ms,
+		   (wakeups * 1000000 / ms) % 1000);
+
+	mutex_unlock(&show_mutex);
+
+	return 0;
+}
+
 /*
  * After a state change, make sure all concurrent lookup/update
  * activities have stopped:
@@ -403,6 +504,18 @@ static const struct file_operations tstats_fops = {
 	.release	= single_release,
 };
 
+static int twakeups_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, twakeups_show, NULL);
+}
+
+static const struct file_operations twakeups_fops = {
+	.open		= twakeups_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void __init init_timer_stats(void)
 {
 	int cpu;
@@ -416,6 +529,9 @@ static int __init init_tstats_procfs(void)
 	struct proc_dir_entry *pe;
 
 	pe = proc_create("timer_stats", 0644, NULL, &tstats_fops);
+	if (!pe)
+		return -ENOMEM;
+	pe = proc_create("timer_wakeups", 0444, NULL, &twakeups_fops);
 	if (!pe)
 		return -ENOMEM;
 	return 0;
@@ -308,6 +308,19 @@ out:
 	return ret;
 }
 
+/*
+ * is_ashmem_file - is @file the shmem file backing an ashmem region?
+ *
+ * That is what vm_file of an ashmem mapping points to, once ashmem_mmap()
+ * is done with it; the backing file is named after the region.
+ */
+int is_ashmem_file(struct file *file)
+{
+	const char *name = file->f_path.dentry->d_name.name;
+
+	return !strncmp(name, ASHMEM_NAME_DEF, sizeof(ASHMEM_NAME_DEF) - 1);
+}
+
 /*
  * ashmem_shrink - our cache shrinker, called from mm/vmscan.c :: shrink_slab
  *
@@ -0,0 +1,521 @@
+/*
+ * mm/ccache.c - compressed second-chance cache for clean file pages
+ *
+ * When reclaim drops a clean page cache page, bringing it back costs a
+ * full read from flash (plus ECC), although the data has not changed.
+ * Instead of forgetting the page, shrink_page_list() compresses it with
+ * ccache_prepare_page() and __remove_mapping() stores the LZO-compressed
+ * copy, keyed by (mapping, index).  Pages dropped by truncation or
+ * invalidation are never stored.  A later page cache miss on that index
+ * is served by decompressing the copy, before ->readpage() or
+ * ->readpages() is called.
+ *
+ * The copy is only good while it matches the data on disk, so it lives
+ * only while there is no page cache page for its index: any page added
+ * to the page cache at that index invalidates it (or was filled from it),
+ * and truncation, direct I/O and inode teardown invalidate whole ranges.
+ *
+ * The compressed data is bounded by max_pages, oldest copies being
+ * dropped first, and shrinks under memory pressure.  Hits, misses and
+ * the current size are reported in /sys/kernel/mm/ccache.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/pagemap.h>
+#include <linux/backing-dev.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/rbtree.h>
+#include <linux/hash.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/percpu.h>
+#include <linux/kobject.h>
+#include <linux/lzo.h>
+#include <linux/ccache.h>
+
+#define CCACHE_HASH_BITS	8
+
+/**
+ * struct ccache_inode - the cached pages of one address_space
+ * @hash: link into ccache_hash
+ * @mapping: the address_space the pages were evicted from
+ * @pages: rbtree of its struct ccache_page, by index
+ */
+struct ccache_inode {
+	struct hlist_node hash;
+	struct address_space *mapping;
+	struct rb_root pages;
+};
+
+/**
+ * struct ccache_page - compressed copy of one evicted page
+ * @node: rb_node in the pages tree of @ci
+ * @lru: link into ccache_lru, most recently put first
+ * @ci: the ccache_inode this page belongs to
+ * @index: page index in the mapping
+ * @len: length of @data
+ * @data: LZO compressed page contents
+ */
+struct ccache_page {
+	struct rb_node node;
+	struct list_head lru;
+	struct ccache_inode *ci;
+	pgoff_t index;
+	unsigned int len;
+	unsigned char data[0];
+};
+
+static struct hlist_head ccache_hash[1 << CCACHE_HASH_BITS];
+static LIST_HEAD(ccache_lru);
+static DEFINE_SPINLOCK(ccache_lock);
+
+/* Compression buffers, used with preemption disabled */
+static DEFINE_PER_CPU(void *, ccache_wrkmem);
+static DEFINE_PER_CPU(unsigned char *, ccache_dst);
+
+/* Limit on the compressed data kept, in pages: 0 disables ccache */
+static unsigned long ccache_max_pages;
+
+/* Pages and bytes currently stored */
+static unsigned long ccache_nr_pages;
+static unsigned long ccache_nr_bytes;
+
+/* Statistics */
+static unsigned long ccache_hits;
+static unsigned long ccache_misses;
+static unsigned long ccache_puts;
+static unsigned long ccache_rejects;
+static unsigned long ccache_evictions;
+
+static struct hlist_head *ccache_bucket(struct address_space *mapping)
+{
+	return &ccache_hash[hash_ptr(mapping, CCACHE_HASH_BITS)];
+}
+
+/* Called with ccache_lock held */
+static struct ccache_inode *ccache_find_inode(struct address_space *mapping)
+{
+	struct ccache_inode *ci;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(ci, node, ccache_bucket(mapping), hash) {
+		if (ci->mapping == mapping)
+			return ci;
+	}
+	return NULL;
+}
+
+/* Called with ccache_lock held */
+static struct ccache_page *ccache_find_page(struct ccache_inode *ci,
+					    pgoff_t index)
+{
+	struct rb_node *node = ci->pages.rb_node;
+	struct ccache_page *cp;
+
+	while (node) {
+		cp = rb_entry(node, struct ccache_page, node);
+		if (index < cp->index)
+			node = node->rb_left;
+		else if (index > cp->index)
+			node = node->rb_right;
+		else
+			return cp;
+	}
+	return NULL;
+}
+
+/*
+ * Unlink @cp, freeing its ccache_inode too if that was the last page.
+ * Called with ccache_lock held; the caller frees @cp.
+ */
+static void ccache_unlink_page(struct ccache_page *cp)
+{
+	struct ccache_inode *ci = cp->ci;
+
+	rb_erase(&cp->node, &ci->pages);
+	list_del(&cp->lru);
+	ccache_nr_pages--;
+	ccache_nr_bytes -= cp->len;
+
+	if (RB_EMPTY_ROOT(&ci->pages)) {
+		hlist_del(&ci->hash);
+		kfree(ci);
+	}
+}
+
+/* Called with ccache_lock held */
+static void ccache_evict_oldest(void)
+{
+	struct ccache_page *cp;
+
+	cp = list_entry(ccache_lru.prev, struct ccache_page, lru);
+	ccache_unlink_page(cp);
+	kfree(cp);
+	ccache_evictions++;
+}
+
+/* Called with ccache_lock held */
+static void ccache_shrink(unsigned long max_bytes)
+{
+	while (ccache_nr_bytes > max_bytes && !list_empty(&ccache_lru))
+		ccache_evict_oldest();
+}
+
+/**
+ * ccache_prepare_page - compress a clean page reclaim is about to evict
+ * @mapping: the address_space of @page
+ * @page: the page, locked, uptodate and clean
+ *
+ * Called by shrink_page_list() before __remove_mapping(), with no
+ * spinlock held, so that compression does not run under tree_lock with
+ * interrupts disabled.  The page is locked and unmapped, so its data
+ * cannot change before __remove_mapping() has taken it out of the page
+ * cache or given up.  Returns the copy to hand to __remove_mapping(), or
+ * NULL if the page is not worth keeping or memory is short.
+ */
+struct ccache_page *ccache_prepare_page(struct address_space *mapping,
+					struct page *page)
+{
+	struct ccache_page *cp = NULL;
+	unsigned char *dst;
+	size_t len;
+	void *src;
+	int ret;
+
+	if (!ccache_max_pages || !PageUptodate(page) || PageDirty(page) ||
+	    mapping_cap_swap_backed(mapping))
+		return NULL;
+
+	/* The per-cpu buffers are used with preemption disabled */
+	dst = get_cpu_var(ccache_dst);
+	src = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_1_compress(src, PAGE_SIZE, dst, &len,
+			       __get_cpu_var(ccache_wrkmem));
+	kunmap_atomic(src, KM_USER0);
+
+	/* Not worth keeping what saves less than a quarter of a page */
+	if (ret == LZO_E_OK && len <= PAGE_SIZE * 3 / 4) {
+		cp = kmalloc(sizeof(*cp) + len,
+			     GFP_NOWAIT | __GFP_NORETRY | __GFP_NOWARN |
+			     __GFP_NOMEMALLOC);
+		if (cp) {
+			cp->index = page->index;
+			cp->len = len;
+			memcpy(cp->data, dst, len);
+		}
+	}
+	put_cpu_var(ccache_dst);
+
+	if (!cp)
+		ccache_rejects++;
+	return cp;
+}
+
+/**
+ * ccache_insert_page - store a copy made by ccache_prepare_page()
+ * @mapping: the address_space its page has just been removed from
+ * @cp: the copy
+ *
+ * Called by __remove_mapping() with @mapping->tree_lock held and
+ * interrupts disabled, right after the page left the page cache, so
+ * that no reader can have brought the page back in between.
+ */
+void ccache_insert_page(struct address_space *mapping, struct ccache_page *cp)
+{
+	struct ccache_inode *ci;
+	struct ccache_page *old;
+	struct rb_node **link, *parent = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ccache_lock, flags);
+	ci = ccache_find_inode(mapping);
+	if (!ci) {
+		ci = kmalloc(sizeof(*ci), GFP_ATOMIC | __GFP_NORETRY |
+			     __GFP_NOWARN | __GFP_NOMEMALLOC);
+		if (!ci) {
+			ccache_rejects++;
+			spin_unlock_irqrestore(&ccache_lock, flags);
+			kfree(cp);
+			return;
+		}
+		ci->mapping = mapping;
+		ci->pages = RB_ROOT;
+		hlist_add_head(&ci->hash, ccache_bucket(mapping));
+	}
+
+	link = &ci->pages.rb_node;
+	while (*link) {
+		parent = *link;
+		old = rb_entry(parent, struct ccache_page, node);
+		if (cp->index < old->index) {
+			link = &parent->rb_left;
+		} else if (cp->index > old->index) {
+			link = &parent->rb_right;
+		} else {
+			/* Should have been invalidated: replace it anyway */
+			rb_replace_node(&old->node, &cp->node, &ci->pages);
+			list_del(&old->lru);
+			ccache_nr_bytes -= old->len;
+			ccache_nr_pages--;
+			kfree(old);
+			goto linked;
+		}
+	}
+	rb_link_node(&cp->node, parent, link);
+	rb_insert_color(&cp->node, &ci->pages);
+linked:
+	cp->ci = ci;
+	list_add(&cp->lru, &ccache_lru);
+	ccache_nr_pages++;
+	ccache_nr_bytes += cp->len;
+	ccache_puts++;
+	ccache_shrink(ccache_max_pages << PAGE_SHIFT);
+	spin_unlock_irqrestore(&ccache_lock, flags);
+}
+
+/**
+ * ccache_free_page - drop a copy __remove_mapping() did not take
+ * @cp: the copy, or NULL
+ */
+void ccache_free_page(struct ccache_page *cp)
+{
+	kfree(cp);
+}
+
+/*
+ * Take the copy of @index out of the cache and decompress it into @page.
+ * Returns 1 if @page was filled.
+ */
+static int ccache_get_page(struct address_space *mapping, pgoff_t index,
+			   struct page *page)
+{
+	struct ccache_inode *ci;
+	struct ccache_page *cp = NULL;
+	unsigned long flags;
+	size_t len = PAGE_SIZE;
+	void *dst;
+	int ret;
+
+	spin_lock_irqsave(&ccache_lock, flags);
+	ci = ccache_find_inode(mapping);
+	if (ci)
+		cp = ccache_find_page(ci, index);
+	if (cp)
+		ccache_unlink_page(cp);
+	spin_unlock_irqrestore(&ccache_lock, flags);
+
+	if (!cp) {
+		ccache_misses++;
+		return 0;
+	}
+
+	dst = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_decompress_safe(cp->data, cp->len, dst, &len);
+	kunmap_atomic(dst, KM_USER0);
+	kfree(cp);
+
+	if (ret != LZO_E_OK || len != PAGE_SIZE) {
+		ccache_misses++;
+		return 0;
+	}
+	flush_dcache_page(page);
+	ccache_hits++;
+	return 1;
+}
+
+/**
+ * ccache_readpage - try to bring a page back from the compressed cache
+ * @mapping: the address_space of the page cache miss
+ * @page: a newly allocated page, not yet in the page cache
+ * @index: the index missed
+ *
+ * Returns 1 if @page was filled and added to the page cache, uptodate
+ * and unlocked; the caller's reference is left to the caller.  Returns
+ * 0 if the caller should read the page in as usual.
+ */
+int ccache_readpage(struct address_space *mapping, struct page *page,
+		    pgoff_t index)
+{
+	if (!ccache_nr_pages)
+		return 0;
+	if (!ccache_get_page(mapping, index, page))
+		return 0;
+	if (add_to_page_cache_lru(page, mapping, index, GFP_KERNEL))
+		return 0;
+	SetPageUptodate(page);
+	unlock_page(page);
+	return 1;
+}
+
+/**
+ * ccache_invalidate_range - drop the copies of pages @start to @end
+ * @mapping: the address_space
+ * @start: first page index
+ * @end: last page index, inclusive
+ */
+void ccache_invalidate_range(struct address_space *mapping,
+			     pgoff_t start, pgoff_t end)
+{
+	struct ccache_inode *ci;
+	struct ccache_page *cp;
+	struct rb_node *node, *next;
+	unsigned long flags;
+
+	if (!ccache_nr_pages)
+		return;
+
+	spin_lock_irqsave(&ccache_lock, flags);
+	ci = ccache_find_inode(mapping);
+	if (!ci)
+		goto out;
+
+	/* Find the leftmost page at or after start */
+	node = ci->pages.rb_node;
+	next = NULL;
+	while (node) {
+		cp = rb_entry(node, struct ccache_page, node);
+		if (cp->index >= start) {
+			next = node;
+			node = node->rb_left;
+		} else
+			node = node->rb_right;
+	}
+
+	while (next) {
+		cp = rb_entry(next, struct ccache_page, node);
+		if (cp->index > end)
+			break;
+		/* Unlinking the last page frees ci, but then next is NULL */
+		next = rb_next(next);
+		ccache_unlink_page(cp);
+		kfree(cp);
+	}
+out:
+	spin_unlock_irqrestore(&ccache_lock, flags);
+}
+
+/*
+ * The compressed copies are unaccounted kernel memory: let the VM shrink
+ * them under pressure like any other cache, oldest first.
+ */
+static int ccache_shrink_pool(int nr_to_scan, gfp_t gfp_mask)
+{
+	unsigned long flags;
+
+	if (nr_to_scan) {
+		spin_lock_irqsave(&ccache_lock, flags);
+		while (nr_to_scan-- > 0 && !list_empty(&ccache_lru))
+			ccache_evict_oldest();
+		spin_unlock_irqrestore(&ccache_lock, flags);
+	}
+	return ccache_nr_pages;
+}
+
+static struct shrinker ccache_shrinker = {
+	.shrink = ccache_shrink_pool,
+	.seeks = DEFAULT_SEEKS,
+};
+
+#ifdef CONFIG_SYSFS
+#define CCACHE_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define CCACHE_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t max_pages_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ccache_max_pages);
+}
+
+static ssize_t max_pages_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	unsigned long nr_pages, flags;
+	int err;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || nr_pages > totalram_pages / 2)
+		return -EINVAL;
+
+	spin_lock_irqsave(&ccache_lock, flags);
+	ccache_max_pages = nr_pages;
+	ccache_shrink(nr_pages << PAGE_SHIFT);
+	spin_unlock_irqrestore(&ccache_lock, flags);
+
+	return count;
+}
+CCACHE_ATTR(max_pages);
+
+#define CCACHE_STAT(_name, _var)					\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%lu\n", _var);				\
+}									\
+CCACHE_ATTR_RO(_name)
+
+CCACHE_STAT(stored_pages, ccache_nr_pages);
+CCACHE_STAT(stored_bytes, ccache_nr_bytes);
+CCACHE_STAT(hits, ccache_hits);
+CCACHE_STAT(misses, ccache_misses);
+CCACHE_STAT(puts, ccache_puts);
+CCACHE_STAT(rejects, ccache_rejects);
+CCACHE_STAT(evictions, ccache_evictions);
+
+static struct attribute *ccache_attrs[] = {
+	&max_pages_attr.attr,
+	&stored_pages_attr.attr,
+	&stored_bytes_attr.attr,
+	&hits_attr.attr,
+	&misses_attr.attr,
+	&puts_attr.attr,
+	&rejects_attr.attr,
+	&evictions_attr.attr,
+	NULL,
+};
+
+static struct attribute_group ccache_attr_group = {
+	.attrs = ccache_attrs,
+	.name = "ccache",
+};
+#endif /* CONFIG_SYSFS */
+
+static int __init ccache_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		per_cpu(ccache_wrkmem, cpu) = vmalloc(LZO1X_1_MEM_COMPRESS);
+		per_cpu(ccache_dst, cpu) =
+			kmalloc(lzo1x_worst_compress(PAGE_SIZE), GFP_KERNEL);
+		if (!per_cpu(ccache_wrkmem, cpu) || !per_cpu(ccache_dst, cpu))
+			goto nomem;
+	}
+
+	/* Up to 1/16th of memory for compressed pages by default */
+	ccache_max_pages = totalram_pages / 16;
+	register_shrinker(&ccache_shrinker);
+
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &ccache_attr_group))
+		printk(KERN_ERR "ccache: register sysfs failed\n");
+#endif
+	return 0;
+
+nomem:
+	for_each_possible_cpu(cpu) {
+		vfree(per_cpu(ccache_wrkmem, cpu));
+		kfree(per_cpu(ccache_dst, cpu));
+	}
+	printk(KERN_ERR "ccache: no memory for compression buffers\n");
+	return -ENOMEM;
+}
+module_init(ccache_init)
@@ -32,7 +32,9 @@
 #include <linux/mmu_notifier.h>
 #include <linux/swap.h>
 #include <linux/ksm.h>
+#include <linux/earlysuspend.h>
 
+#include <asm/div64.h>
 #include <asm/tlbflush.h>
 #include "internal.h"
 
@@ -172,6 +174,31 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Percentage of one cpu ksmd may use: 0 for no limit */
+static unsigned int ksm_thread_max_cpu_percent;
+
+/* Whether ksmd should stay idle while the screen is on */
+static unsigned int ksm_pause_screen_on = 1;
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static int ksm_screen_on = 1;
+#else
+#define ksm_screen_on	0
+#endif
+
+/*
+ * Reclaim noticed by our shrinker keeps ksmd scanning, even with the
+ * screen on, until ksm_pressure_until: see ksm_under_pressure().
+ */
+#define KSM_PRESSURE_MSECS	1000
+static unsigned long ksm_pressure_until = INITIAL_JIFFIES;
+
+/* Checksum of a zero-filled page, for merging those at first sight */
+static u32 zero_checksum;
+
+/* The number of pages ksmd has scanned, and the cpu time spent on it */
+static unsigned long ksm_pages_scanned;
+static u64 ksm_cpu_time_ns;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -181,6 +208,11 @@ static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
 static DEFINE_MUTEX(ksm_thread_mutex);
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
 
+static inline int ksm_under_pressure(void)
+{
+	return time_before(jiffies, ksm_pressure_until);
+}
+
 #define KSM_KMEM_CACHE(__struct, __flags) kmem_cache_create("ksm_"#__struct,\
 		sizeof(struct __struct), __alignof__(struct __struct),\
 		(__flags), NULL)
@@ -1124,11 +1156,16 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	 * have calculated it, this page to be changed frequely, therefore we
 	 * don't want to insert it to the unstable tree, and we don't want to
 	 * waste our time to search if there is something identical to it there.
+	 *
+	 * Zero-filled pages are the exception: freshly forked app heaps are
+	 * full of them, and they are cheap to find in the unstable tree.
+	 * Under memory pressure, don't wait a full scan for any page.
 	 */
 	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
-		return;
+		if (checksum != zero_checksum && !ksm_under_pressure())
+			return;
 	}
 
 	tree_rmap_item = unstable_tree_search_insert(page, page2, rmap_item);
@@ -1275,7 +1312,8 @@ next_mm:
 	spin_lock(&ksm_mmlist_lock);
 	ksm_scan.mm_slot = list_entry(slot->mm_list.next,
 						struct mm_slot, mm_list);
-	if (ksm_scan.address == 0) {
+	if (ksm_scan.address == 0 &&
+	    (ksm_test_exit(mm) || !test_bit(MMF_VM_MERGE_ANY, &mm->flags))) {
 		/*
 		 * We've completed a full scan of all vmas, holding mmap_sem
 		 * throughout, and found no VM_MERGEABLE: so do the same as
@@ -1284,6 +1322,7 @@ next_mm:
 		 * (but beware: we can reach here even before __ksm_exit),
 		 * or when all VM_MERGEABLE areas have been unmapped (and
 		 * mmap_sem then protects against race with MADV_MERGEABLE).
+		 * An mm opted in by prctl stays, to catch its future areas.
 		 */
 		hlist_del(&slot->link);
 		list_del(&slot->mm_list);
@@ -1321,6 +1360,7 @@ static void ksm_do_scan(unsigned int scan_npages)
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
 			return;
+		ksm_pages_scanned++;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
 			cmp_and_merge_page(page, rmap_item);
 		else if (page_mapcount(page) == 1) {
@@ -1337,22 +1377,54 @@ static void ksm_do_scan(unsigned int scan_npages)
 
 static int ksmd_should_run(void)
 {
-	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
+	if (!(ksm_run & KSM_RUN_MERGE) || list_empty(&ksm_mm_head.mm_list))
+		return 0;
+	/*
+	 * Scanning while the user is looking at the screen competes with
+	 * the foreground app for cpu and memory bandwidth: wait for the
+	 * screen to go off, unless reclaim is asking for memory back.
+	 */
+	if (ksm_screen_on && ksm_pause_screen_on && !ksm_under_pressure())
+		return 0;
+	return 1;
+}
+
+/*
+ * Stretch the sleep after a batch which took @runtime ns of cpu, so that
+ * ksmd stays within ksm_thread_max_cpu_percent of one cpu.
+ */
+static unsigned long ksm_sleep_jiffies(u64 runtime)
+{
+	unsigned int percent = ksm_thread_max_cpu_percent;
+	unsigned int msecs = ksm_thread_sleep_millisecs;
+	u64 min_msecs;
+
+	if (percent && percent < 100) {
+		min_msecs = runtime * (100 - percent);
+		do_div(min_msecs, percent * NSEC_PER_MSEC);
+		if (min_msecs > msecs)
+			msecs = min_t(u64, min_msecs, MSEC_PER_SEC * 60);
+	}
+	return msecs_to_jiffies(msecs);
 }
 
 static int ksm_scan_thread(void *nothing)
 {
+	u64 runtime;
+
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
+		runtime = task_sched_runtime(current);
 		mutex_lock(&ksm_thread_mutex);
 		if (ksmd_should_run())
 			ksm_do_scan(ksm_thread_pages_to_scan);
 		mutex_unlock(&ksm_thread_mutex);
+		runtime = task_sched_runtime(current) - runtime;
+		ksm_cpu_time_ns += runtime;
 
 		if (ksmd_should_run()) {
-			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+			schedule_timeout_interruptible(ksm_sleep_jiffies(runtime));
 		} else {
 			wait_event_interruptible(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1372,10 +1444,7 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		/*
 		 * Be somewhat over-protective for now!
 		 */
-		if (*vm_flags & (VM_MERGEABLE | VM_SHARED  | VM_MAYSHARE   |
-				 VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
-				 VM_RESERVED  | VM_HUGETLB | VM_INSERTPAGE |
-				 VM_MIXEDMAP  | VM_SAO))
+		if (*vm_flags & (VM_MERGEABLE | VM_KSM_EXCLUDE))
 			return 0;		/* just ignore the advice */
 
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
@@ -1404,6 +1473,49 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 	return 0;
 }
 
+/*
+ * Reclaim consults every shrinker: take that as the hint that memory is
+ * short, and let ksmd merge at full rate for a while.  We have nothing
+ * to free directly, so report no objects.
+ */
+static int ksm_shrink(int nr_to_scan, gfp_t gfp_mask)
+{
+	int was_idle;
+
+	if (!(ksm_run & KSM_RUN_MERGE))
+		return 0;
+
+	was_idle = !ksm_under_pressure();
+	ksm_pressure_until = jiffies + msecs_to_jiffies(KSM_PRESSURE_MSECS);
+	if (was_idle)
+		wake_up_interruptible(&ksm_thread_wait);
+	return 0;
+}
+
+static struct shrinker ksm_shrinker = {
+	.shrink = ksm_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void ksm_early_suspend(struct early_suspend *h)
+{
+	ksm_screen_on = 0;
+	wake_up_interruptible(&ksm_thread_wait);
+}
+
+static void ksm_late_resume(struct early_suspend *h)
+{
+	ksm_screen_on = 1;
+}
+
+static struct early_suspend ksm_early_suspend_desc = {
+	.level = EARLY_SUSPEND_LEVEL_DISABLE_FB + 1,
+	.suspend = ksm_early_suspend,
+	.resume = ksm_late_resume,
+};
+#endif
+
 int __ksm_enter(struct mm_struct *mm)
 {
 	struct mm_slot *mm_slot;
@@ -1435,6 +1547,56 @@ int __ksm_enter(struct mm_struct *mm)
 	return 0;
 }
 
+/*
+ * ksm_enable_merge_any - prctl(PR_SET_KSM, 1): make every private area of
+ * @mm, present and future, VM_MERGEABLE.  Called with mmap_sem held for
+ * writing, which keeps ksmd from dropping the mm_slot meanwhile.
+ */
+int ksm_enable_merge_any(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	int err;
+
+	if (test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		return 0;
+
+	if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
+		err = __ksm_enter(mm);
+		if (err)
+			return err;
+	}
+
+	set_bit(MMF_VM_MERGE_ANY, &mm->flags);
+	for (vma = mm->mmap; vma; vma = vma->vm_next)
+		vma->vm_flags = ksm_vm_flags(mm, vma->vm_flags);
+	return 0;
+}
+
+/*
+ * ksm_disable_merge_any - prctl(PR_SET_KSM, 0): unmerge and clear
+ * VM_MERGEABLE on every area of @mm, madvised or not.  Called with
+ * mmap_sem held for writing; ksmd frees the mm_slot on its next pass.
+ */
+int ksm_disable_merge_any(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	int err;
+
+	clear_bit(MMF_VM_MERGE_ANY, &mm->flags);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (!(vma->vm_flags & VM_MERGEABLE))
+			continue;
+		if (vma->anon_vma) {
+			err = unmerge_ksm_pages(vma, vma->vm_start,
+						vma->vm_end);
+			if (err)
+				return err;
+		}
+		vma->vm_flags &= ~VM_MERGEABLE;
+	}
+	return 0;
+}
+
 void __ksm_exit(struct mm_struct *mm)
 {
 	struct mm_slot *mm_slot;
@@ -1507,6 +1669,54 @@ static ssize_t sleep_millisecs_store(struct kobject *kobj,
 }
 KSM_ATTR(sleep_millisecs);
 
+static ssize_t max_cpu_percent_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_max_cpu_percent);
+}
+
+static ssize_t max_cpu_percent_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	unsigned long percent;
+	int err;
+
+	err = strict_strtoul(buf, 10, &percent);
+	if (err || percent > 100)
+		return -EINVAL;
+
+	ksm_thread_max_cpu_percent = percent;
+
+	return count;
+}
+KSM_ATTR(max_cpu_percent);
+
+static ssize_t pause_screen_on_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_pause_screen_on);
+}
+
+static ssize_t pause_screen_on_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	unsigned long pause;
+	int err;
+
+	err = strict_strtoul(buf, 10, &pause);
+	if (err || pause > 1)
+		return -EINVAL;
+
+	ksm_pause_screen_on = pause;
+	if (!pause)
+		wake_up_interruptible(&ksm_thread_wait);
+
+	return count;
+}
+KSM_ATTR(pause_screen_on);
+
 static ssize_t pages_to_scan_show(struct kobject *kobj,
 				  struct kobj_attribute *attr, char *buf)
 {
@@ -1645,6 +1855,23 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t pages_scanned_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_scanned);
+}
+KSM_ATTR_RO(pages_scanned);
+
+static ssize_t cpu_time_msecs_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	u64 msecs = ksm_cpu_time_ns;
+
+	do_div(msecs, NSEC_PER_MSEC);
+	return sprintf(buf, "%llu\n", (unsigned long long)msecs);
+}
+KSM_ATTR_RO(cpu_time_msecs);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -1655,6 +1882,10 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&max_cpu_percent_attr.attr,
+	&pause_screen_on_attr.attr,
+	&pages_scanned_attr.attr,
+	&cpu_time_msecs_attr.attr,
 	NULL,
 };
 
@@ -1670,6 +1901,7 @@ static int __init ksm_init(void)
 	int err;
 
 	ksm_max_kernel_pages = totalram_pages / 4;
+	zero_checksum = calc_checksum(ZERO_PAGE(0));
 
 	err = ksm_slab_init();
 	if (err)
@@ -1698,6 +1930,10 @@ static int __init ksm_init(void)
 
 #endif /* CONFIG_SYSFS */
 
+	register_shrinker(&ksm_shrinker);
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&ksm_early_suspend_desc);
+#endif
 	return 0;
 
 out_free2:
@@ -16,6 +16,7 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/ccache.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -177,9 +178,13 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (!page)
 			break;
 		page->index = page_offset;
-		list_add(&page->lru, &page_pool);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
+		if (ccache_readpage(mapping, page, page_offset)) {
+			page_cache_release(page);
+			continue;
+		}
+		list_add(&page->lru, &page_pool);
 		ret++;
 	}
 
@@ -0,0 +1,433 @@
+/*
+ * mm/readahead_profile.c - replay of recorded per-file access patterns
+ *
+ * Application start-up reads its APK and dex files at scattered offsets,
+ * which the sequential heuristics of ondemand_readahead() serve badly:
+ * they read too much around some misses, and nothing ahead of the next
+ * one.  But the offsets are much the same from one launch to the next.
+ *
+ * So, while enabled, we remember for each inode the extents of the page
+ * cache misses taken on it, merged into at most RA_PROFILE_EXTENTS
+ * extents.  In replay mode, the first miss through a newly opened file
+ * submits reads for the whole recorded profile of its inode at once, so
+ * that the I/O is issued in a few large batches instead of one blocking
+ * read per miss.  Misses outside the profile keep refining it.
+ *
+ * Profiles are kept in memory only, and are dropped when a file changes
+ * size or modification time.  Once RA_PROFILE_MAX profiles exist, the one
+ * least recently missed on or replayed is recycled for a new inode, so
+ * that files recorded early, such as system libraries, do not keep out
+ * the ones opened by later launches.  /sys/kernel/mm/readahead_profile/misses
+ * counts the page cache misses taken, to compare launches with and
+ * without replay.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/spinlock.h>
+#include <linux/kobject.h>
+#include <linux/pagemap.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#define RA_PROFILE_EXTENTS	32
+#define RA_PROFILE_MAX		256
+#define RA_PROFILE_HASH_BITS	6
+
+/* Most pages one replay may read in, on top of max_sane_readahead() */
+#define RA_PROFILE_MAX_REPLAY	((8 * 1024 * 1024) / PAGE_CACHE_SIZE)
+
+#define RA_PROFILE_OFF		0
+#define RA_PROFILE_RECORD	1
+#define RA_PROFILE_REPLAY	2
+
+struct ra_extent {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+/**
+ * struct ra_profile - recorded page cache misses on one inode
+ * @hash: link into ra_profile_hash
+ * @lru: link into ra_profile_lru, least recently used first
+ * @dev: device of the inode
+ * @ino: inode number
+ * @size: i_size when recorded, to notice the file being replaced
+ * @mtime: i_mtime when recorded, likewise
+ * @nr_extents: number of valid entries in @extents
+ * @extents: disjoint extents of missed pages, sorted by start
+ */
+struct ra_profile {
+	struct hlist_node hash;
+	struct list_head lru;
+	dev_t dev;
+	unsigned long ino;
+	loff_t size;
+	struct timespec mtime;
+	unsigned int nr_extents;
+	struct ra_extent extents[RA_PROFILE_EXTENTS];
+};
+
+static struct hlist_head ra_profile_hash[1 << RA_PROFILE_HASH_BITS];
+static LIST_HEAD(ra_profile_lru);
+static DEFINE_SPINLOCK(ra_profile_lock);
+static unsigned int ra_profile_count;
+
+static unsigned int ra_profile_mode = RA_PROFILE_OFF;
+
+/* Statistics */
+static unsigned long ra_profile_misses;
+static unsigned long ra_profile_replays;
+static unsigned long ra_profile_replayed_pages;
+
+static struct hlist_head *ra_profile_bucket(dev_t dev, unsigned long ino)
+{
+	return &ra_profile_hash[hash_long(ino ^ dev, RA_PROFILE_HASH_BITS)];
+}
+
+/* Called with ra_profile_lock held; marks the profile found as used */
+static struct ra_profile *ra_profile_lookup(struct inode *inode)
+{
+	struct hlist_head *bucket;
+	struct hlist_node *node;
+	struct ra_profile *prof;
+
+	bucket = ra_profile_bucket(inode->i_sb->s_dev, inode->i_ino);
+	hlist_for_each_entry(prof, node, bucket, hash) {
+		if (prof->ino != inode->i_ino || prof->dev != inode->i_sb->s_dev)
+			continue;
+		if (prof->size != i_size_read(inode) ||
+		    !timespec_equal(&prof->mtime, &inode->i_mtime)) {
+			/* Stale: start again */
+			prof->size = i_size_read(inode);
+			prof->mtime = inode->i_mtime;
+			prof->nr_extents = 0;
+		}
+		list_move_tail(&prof->lru, &ra_profile_lru);
+		return prof;
+	}
+	return NULL;
+}
+
+/* Called with ra_profile_lock held */
+static void ra_profile_insert(struct ra_profile *prof, struct inode *inode)
+{
+	prof->dev = inode->i_sb->s_dev;
+	prof->ino = inode->i_ino;
+	prof->size = i_size_read(inode);
+	prof->mtime = inode->i_mtime;
+	prof->nr_extents = 0;
+	hlist_add_head(&prof->hash, ra_profile_bucket(prof->dev, prof->ino));
+	list_add_tail(&prof->lru, &ra_profile_lru);
+}
+
+/*
+ * Merge [start, start + nr) into the sorted extents of @prof.  When all
+ * slots are taken, the two extents closest together are joined, reading
+ * the gap between them rather than forgetting either.
+ */
+static void ra_profile_add(struct ra_profile *prof, pgoff_t start,
+			   unsigned long nr)
+{
+	struct ra_extent *ext = prof->extents;
+	pgoff_t end = start + nr;
+	unsigned long gap, best_gap;
+	unsigned int i, j, best;
+
+	for (i = 0; i < prof->nr_extents; i++) {
+		if (end < ext[i].start)
+			break;
+		if (start > ext[i].start + ext[i].nr)
+			continue;
+		/* Overlapping or adjacent: extend, then absorb successors */
+		end = max_t(pgoff_t, end, ext[i].start + ext[i].nr);
+		ext[i].start = min(ext[i].start, start);
+		ext[i].nr = end - ext[i].start;
+		for (j = i + 1; j < prof->nr_extents &&
+				ext[j].start <= end; j++) {
+			end = max_t(pgoff_t, end, ext[j].start + ext[j].nr);
+			ext[i].nr = end - ext[i].start;
+		}
+		memmove(&ext[i + 1], &ext[j],
+			(prof->nr_extents - j) * sizeof(*ext));
+		prof->nr_extents -= j - i - 1;
+		return;
+	}
+
+	if (prof->nr_extents == RA_PROFILE_EXTENTS) {
+		best = 0;
+		best_gap = ULONG_MAX;
+		for (j = 0; j + 1 < prof->nr_extents; j++) {
+			gap = ext[j + 1].start - (ext[j].start + ext[j].nr);
+			if (gap < best_gap) {
+				best_gap = gap;
+				best = j;
+			}
+		}
+		ext[best].nr = ext[best + 1].start + ext[best + 1].nr -
+				ext[best].start;
+		memmove(&ext[best + 1], &ext[best + 2],
+			(prof->nr_extents - best - 2) * sizeof(*ext));
+		prof->nr_extents--;
+		if (i == best + 1)
+			return;		/* it fell in the gap just joined */
+		if (i > best + 1)
+			i--;
+	}
+
+	memmove(&ext[i + 1], &ext[i], (prof->nr_extents - i) * sizeof(*ext));
+	ext[i].start = start;
+	ext[i].nr = nr;
+	prof->nr_extents++;
+}
+
+/*
+ * Submit reads for every recorded extent of @inode's profile.  The pages
+ * already cached are skipped by __do_page_cache_readahead().
+ */
+static void ra_profile_replay(struct address_space *mapping,
+			      struct file *filp)
+{
+	struct inode *inode = mapping->host;
+	struct ra_extent extents[RA_PROFILE_EXTENTS];
+	struct ra_profile *prof;
+	unsigned long budget;
+	unsigned int i, nr_extents = 0;
+	int ret;
+
+	spin_lock(&ra_profile_lock);
+	prof = ra_profile_lookup(inode);
+	if (prof) {
+		nr_extents = prof->nr_extents;
+		memcpy(extents, prof->extents, nr_extents * sizeof(*extents));
+	}
+	spin_unlock(&ra_profile_lock);
+
+	if (!nr_extents)
+		return;
+
+	budget = max_sane_readahead(RA_PROFILE_MAX_REPLAY);
+	for (i = 0; i < nr_extents && budget; i++) {
+		ret = force_page_cache_readahead(mapping, filp,
+				extents[i].start, min(extents[i].nr, budget));
+		if (ret < 0)
+			break;
+		ra_profile_replayed_pages += ret;
+		budget -= min(extents[i].nr, budget);
+	}
+	ra_profile_replays++;
+}
+
+/**
+ * readahead_profile_miss - note a page cache miss for the profiles
+ * @mapping: address_space of the file
+ * @ra: readahead state of the open file
+ * @filp: the open file
+ * @offset: first page missed
+ * @nr: number of pages the caller wants from @offset
+ *
+ * Called on a synchronous page cache miss, before any readahead is
+ * decided on.  The first miss through an open file replays its profile.
+ */
+void readahead_profile_miss(struct address_space *mapping,
+			    struct file_ra_state *ra, struct file *filp,
+			    pgoff_t offset, unsigned long nr)
+{
+	struct inode *inode = mapping->host;
+	struct ra_profile *prof, *new = NULL;
+	unsigned int mode = ra_profile_mode;
+
+	if (mode == RA_PROFILE_OFF || !S_ISREG(inode->i_mode))
+		return;
+
+	ra_profile_misses++;
+	if (mode == RA_PROFILE_REPLAY && ra->prev_pos == -1)
+		ra_profile_replay(mapping, filp);
+
+	nr = clamp_t(unsigned long, nr, 1, ra->ra_pages ? ra->ra_pages : 1);
+retry:
+	spin_lock(&ra_profile_lock);
+	prof = ra_profile_lookup(inode);
+	if (!prof && new) {
+		prof = new;
+		new = NULL;
+		ra_profile_insert(prof, inode);
+		ra_profile_count++;
+	} else if (!prof && ra_profile_count >= RA_PROFILE_MAX) {
+		/* Recycle the least recently used profile */
+		prof = list_first_entry(&ra_profile_lru, struct ra_profile,
+					lru);
+		hlist_del(&prof->hash);
+		list_del(&prof->lru);
+		ra_profile_insert(prof, inode);
+	}
+	if (prof)
+		ra_profile_add(prof, offset, nr);
+	else {
+		spin_unlock(&ra_profile_lock);
+		new = kzalloc(sizeof(*new), GFP_NOFS | __GFP_NOWARN);
+		if (new)
+			goto retry;
+		return;
+	}
+	spin_unlock(&ra_profile_lock);
+	kfree(new);
+}
+
+static void ra_profile_clear(void)
+{
+	struct ra_profile *prof;
+	struct hlist_node *node, *next;
+	HLIST_HEAD(dead);
+	int i;
+
+	spin_lock(&ra_profile_lock);
+	for (i = 0; i < ARRAY_SIZE(ra_profile_hash); i++) {
+		hlist_for_each_entry_safe(prof, node, next,
+					  &ra_profile_hash[i], hash) {
+			hlist_del(&prof->hash);
+			hlist_add_head(&prof->hash, &dead);
+		}
+	}
+	INIT_LIST_HEAD(&ra_profile_lru);
+	ra_profile_count = 0;
+	spin_unlock(&ra_profile_lock);
+
+	hlist_for_each_entry_safe(prof, node, next, &dead, hash)
+		kfree(prof);
+}
+
+#ifdef CONFIG_SYSFS
+#define RA_PROFILE_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define RA_PROFILE_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t mode_show(struct kobject *kobj, struct kobj_attribute *attr,
+			 char *buf)
+{
+	return sprintf(buf, "%u\n", ra_profile_mode);
+}
+
+/*
+ * 0: off; 1: record misses only; 2: record, and replay on first miss.
+ * Writing 0 also forgets all profiles.
+ */
+static ssize_t mode_store(struct kobject *kobj, struct kobj_attribute *attr,
+			  const char *buf, size_t count)
+{
+	unsigned long mode;
+	int err;
+
+	err = strict_strtoul(buf, 10, &mode);
+	if (err || mode > RA_PROFILE_REPLAY)
+		return -EINVAL;
+
+	ra_profile_mode = mode;
+	if (mode == RA_PROFILE_OFF)
+		ra_profile_clear();
+
+	return count;
+}
+RA_PROFILE_ATTR(mode);
+
+static ssize_t misses_show(struct kobject *kobj, struct kobj_attribute *attr,
+			   char *buf)
+{
+	return sprintf(buf, "%lu\n", ra_profile_misses);
+}
+RA_PROFILE_ATTR_RO(misses);
+
+static ssize_t replays_show(struct kobject *kobj, struct kobj_attribute *attr,
+			    char *buf)
+{
+	return sprintf(buf, "%lu\n", ra_profile_replays);
+}
+RA_PROFILE_ATTR_RO(replays);
+
+static ssize_t replayed_pages_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ra_profile_replayed_pages);
+}
+RA_PROFILE_ATTR_RO(replayed_pages);
+
+static ssize_t profiles_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ra_profile_count);
+}
+RA_PROFILE_ATTR_RO(profiles);
+
+static struct attribute *ra_profile_attrs[] = {
+	&mode_attr.attr,
+	&misses_attr.attr,
+	&replays_attr.attr,
+	&replayed_pages_attr.attr,
+	&profiles_attr.attr,
+	NULL,
+};
+
+static struct attribute_group ra_profile_attr_group = {
+	.attrs = ra_profile_attrs,
+	.name = "readahead_profile",
+};
+#endif /* CONFIG_SYSFS */
+
+#ifdef CONFIG_DEBUG_FS
+/* One line per profile: dev ino size, then start+nr of each extent */
+static int ra_profile_debug_show(struct seq_file *m, void *v)
+{
+	struct ra_profile *prof;
+	struct hlist_node *node;
+	unsigned int i, j;
+
+	spin_lock(&ra_profile_lock);
+	for (i = 0; i < ARRAY_SIZE(ra_profile_hash); i++) {
+		hlist_for_each_entry(prof, node, &ra_profile_hash[i], hash) {
+			seq_printf(m, "%u:%u %lu %lld", MAJOR(prof->dev),
+				   MINOR(prof->dev), prof->ino,
+				   (long long)prof->size);
+			for (j = 0; j < prof->nr_extents; j++)
+				seq_printf(m, " %lu+%lu",
+					   (unsigned long)prof->extents[j].start,
+					   prof->extents[j].nr);
+			seq_putc(m, '\n');
+		}
+	}
+	spin_unlock(&ra_profile_lock);
+	return 0;
+}
+
+static int ra_profile_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ra_profile_debug_show, NULL);
+}
+
+static const struct file_operations ra_profile_debug_fops = {
+	.open		= ra_profile_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif /* CONFIG_DEBUG_FS */
+
+static int __init readahead_profile_init(void)
+{
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &ra_profile_attr_group))
+		printk(KERN_ERR "readahead_profile: register sysfs failed\n");
+#endif
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("readahead_profile", 0444, NULL, NULL,
+			    &ra_profile_debug_fops);
+#endif
+	return 0;
+}
+module_init(readahead_profile_init)
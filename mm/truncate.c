@@ -16,6 +16,7 @@
 #include <linux/highmem.h>
 #include <linux/pagevec.h>
 #include <linux/task_io_accounting_ops.h>
+#include <linux/ccache.h>
 #include <linux/buffer_head.h>	/* grr. try_to_release_page,
 				   do_invalidatepage */
 #include "internal.h"
@@ -214,6 +215,9 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	pgoff_t next;
 	int i;
 
+	/* Also drops a compressed copy of the partial page */
+	ccache_invalidate_range(mapping, lstart >> PAGE_CACHE_SHIFT,
+				lend >> PAGE_CACHE_SHIFT);
 	if (mapping->nrpages == 0)
 		return;
 
@@ -287,6 +291,8 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		}
 		pagevec_release(&pvec);
 	}
+	/* Pages reclaimed while we were walking the range */
+	ccache_invalidate_range(mapping, lstart >> PAGE_CACHE_SHIFT, end);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
 
@@ -324,6 +330,8 @@ unsigned long invalidate_mapping_pages(struct address_space *mapping,
 	unsigned long ret = 0;
 	int i;
 
+	/* The caller wants the data dropped, not kept compressed */
+	ccache_invalidate_range(mapping, start, end);
 	pagevec_init(&pvec, 0);
 	while (next <= end &&
 			pagevec_lookup(&pvec, mapping, next, PAGEVEC_SIZE)) {
@@ -423,6 +431,7 @@ int invalidate_inode_pages2_range(struct address_space *mapping,
 	int did_range_unmap = 0;
 	int wrapped = 0;
 
+	ccache_invalidate_range(mapping, start, end);
 	pagevec_init(&pvec, 0);
 	next = start;
 	while (next <= end && !wrapped &&
@@ -479,6 +488,7 @@ int invalidate_inode_pages2_range(struct address_space *mapping,
 		pagevec_release(&pvec);
 		cond_resched();
 	}
+	ccache_invalidate_range(mapping, start, end);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(invalidate_inode_pages2_range);
@@ -40,6 +40,7 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/ccache.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -48,6 +49,9 @@
 
 #include "internal.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/vmscan.h>
+
 struct scan_control {
 	/* Incremented by the number of inactive pages that were scanned */
 	unsigned long nr_scanned;
@@ -182,6 +186,17 @@ void unregister_shrinker(struct shrinker *shrinker)
 EXPORT_SYMBOL(unregister_shrinker);
 
 #define SHRINK_BATCH 128
+
+/* LRU pages direct reclaim scans between calls to the shrinkers */
+#define SHRINK_SLAB_BATCH (SWAP_CLUSTER_MAX * 4)
+
+/*
+ * LRU pages scanned by direct reclaim and not yet passed on to the
+ * shrinkers.  Shared by all direct reclaimers, so that the pressure of
+ * calls which succeed after a light pass is not lost.
+ */
+static atomic_long_t slab_scanned_pending = ATOMIC_LONG_INIT(0);
+
 /*
  * Call the shrink functions to age shrinkable caches
  *
@@ -217,6 +232,9 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 		unsigned long long delta;
 		unsigned long total_scan;
 		unsigned long max_pass = (*shrinker->shrink)(0, gfp_mask);
+		unsigned long nr_freed = 0;
+		int nr_before = max_pass;
+		int nr_calls = 0;
 
 		delta = (4 * scanned) / shrinker->seeks;
 		delta *= max_pass;
@@ -240,23 +258,37 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 		total_scan = shrinker->nr;
 		shrinker->nr = 0;
 
+		if (total_scan >= SHRINK_BATCH)
+			trace_mm_vmscan_shrink_slab_begin(shrinker->shrink,
+							  max_pass, total_scan);
+
+		/*
+		 * A shrinker returns the number of objects left, which is
+		 * what the next batch starts from: don't ask it to count them
+		 * again, some shrinkers (lowmemorykiller) walk every task to
+		 * do so.
+		 */
 		while (total_scan >= SHRINK_BATCH) {
 			long this_scan = SHRINK_BATCH;
 			int shrink_ret;
-			int nr_before;
 
-			nr_before = (*shrinker->shrink)(0, gfp_mask);
 			shrink_ret = (*shrinker->shrink)(this_scan, gfp_mask);
+			nr_calls++;
 			if (shrink_ret == -1)
 				break;
 			if (shrink_ret < nr_before)
-				ret += nr_before - shrink_ret;
+				nr_freed += nr_before - shrink_ret;
+			nr_before = shrink_ret;
 			count_vm_events(SLABS_SCANNED, this_scan);
 			total_scan -= this_scan;
 
 			cond_resched();
 		}
 
+		if (nr_calls)
+			trace_mm_vmscan_shrink_slab_end(shrinker->shrink,
+							nr_freed, nr_calls);
+		ret += nr_freed;
 		shrinker->nr += total_scan;
 	}
 	up_read(&shrinker_rwsem);
@@ -429,9 +461,12 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
- * gets returned with a refcount of 0.
+ * gets returned with a refcount of 0.  If the page is removed, the
+ * compressed copy @ccp (may be NULL) is handed to ccache; otherwise it
+ * is left to the caller.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    struct ccache_page *ccp)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -477,6 +512,8 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		swapcache_free(swap, page);
 	} else {
 		__remove_from_page_cache(page);
+		if (ccp)
+			ccache_insert_page(mapping, ccp);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 	}
@@ -496,7 +533,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, NULL)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -598,6 +635,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 	pagevec_init(&freed_pvec, 1);
 	while (!list_empty(page_list)) {
 		struct address_space *mapping;
+		struct ccache_page *ccp;
 		struct page *page;
 		int may_enter_fs;
 		int referenced;
@@ -758,9 +796,16 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping)
 			goto keep_locked;
 
+		/* Only pages dropped by reclaim go to ccache */
+		ccp = ccache_prepare_page(mapping, page);
+		if (!__remove_mapping(mapping, page, ccp)) {
+			ccache_free_page(ccp);
+			goto keep_locked;
+		}
+
 		/*
 		 * At this point, we have no other references and there is
 		 * no way to pick any more up (removed from LRU, removed
@@ -1066,9 +1111,13 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 			int priority, int file)
 {
 	LIST_HEAD(page_list);
+	LIST_HEAD(unevictable);
 	struct pagevec pvec;
 	unsigned long nr_scanned = 0;
 	unsigned long nr_reclaimed = 0;
+	unsigned long nr_taken_total = 0;
+	unsigned long nr_rotated = 0;
+	unsigned int nr_lock_holds = 1;
 	struct zone_reclaim_stat *reclaim_stat = get_reclaim_stat(zone, sc);
 	int lumpy_reclaim = 0;
 
@@ -1086,6 +1135,9 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 
 	pagevec_init(&pvec, 1);
 
+	trace_mm_vmscan_lru_shrink_begin(zone_to_nid(zone), zone_idx(zone),
+					 priority, 0, file);
+
 	lru_add_drain();
 	spin_lock_irq(&zone->lru_lock);
 	do {
@@ -1115,6 +1167,7 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 
 		if (nr_taken == 0)
 			goto done;
+		nr_taken_total += nr_taken;
 
 		nr_active = clear_active_flags(&page_list, count);
 		__count_vm_events(PGDEACTIVATE, nr_active);
@@ -1172,41 +1225,57 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 		__count_zone_vm_events(PGSTEAL, zone, nr_freed);
 
 		spin_lock(&zone->lru_lock);
+		nr_lock_holds++;
 		/*
-		 * Put back any unfreeable pages.
+		 * Put back any unfreeable pages.  Unevictable ones go through
+		 * putback_lru_page(), which takes lru_lock itself: set them
+		 * aside rather than dropping the lock for each.
 		 */
 		while (!list_empty(&page_list)) {
 			int lru;
 			page = lru_to_page(&page_list);
 			VM_BUG_ON(PageLRU(page));
-			list_del(&page->lru);
 			if (unlikely(!page_evictable(page, NULL))) {
-				spin_unlock_irq(&zone->lru_lock);
-				putback_lru_page(page);
-				spin_lock_irq(&zone->lru_lock);
+				list_move(&page->lru, &unevictable);
 				continue;
 			}
+			list_del(&page->lru);
 			SetPageLRU(page);
 			lru = page_lru(page);
 			add_page_to_lru_list(zone, page, lru);
 			if (is_active_lru(lru)) {
 				int file = is_file_lru(lru);
 				reclaim_stat->recent_rotated[file]++;
+				nr_rotated++;
 			}
 			if (!pagevec_add(&pvec, page)) {
 				spin_unlock_irq(&zone->lru_lock);
 				__pagevec_release(&pvec);
 				spin_lock_irq(&zone->lru_lock);
+				nr_lock_holds++;
 			}
 		}
 		__mod_zone_page_state(zone, NR_ISOLATED_ANON, -nr_anon);
 		__mod_zone_page_state(zone, NR_ISOLATED_FILE, -nr_file);
 
+		if (unlikely(!list_empty(&unevictable))) {
+			spin_unlock_irq(&zone->lru_lock);
+			while (!list_empty(&unevictable)) {
+				page = lru_to_page(&unevictable);
+				list_del(&page->lru);
+				putback_lru_page(page);
+			}
+			spin_lock_irq(&zone->lru_lock);
+			nr_lock_holds++;
+		}
+
   	} while (nr_scanned < max_scan);
 
 done:
 	spin_unlock_irq(&zone->lru_lock);
 	pagevec_release(&pvec);
+	trace_mm_vmscan_lru_shrink_end(nr_scanned, nr_taken_total,
+				       nr_reclaimed, nr_rotated, nr_lock_holds);
 	return nr_reclaimed;
 }
 
@@ -1240,18 +1309,22 @@ static inline void note_zone_scanning_priority(struct zone *zone, int priority)
  *
  * The downside is that we have to touch page->_count against each page.
  * But we had to alter page->flags anyway.
+ *
+ * The references taken by isolation are dropped through @pvec, which is
+ * only released under the lock when it fills up: the caller releases what
+ * is left after dropping lru_lock.  Returns how many times lru_lock had
+ * to be dropped and taken again.
  */
 
-static void move_active_pages_to_lru(struct zone *zone,
-				     struct list_head *list,
-				     enum lru_list lru)
+static unsigned int move_active_pages_to_lru(struct zone *zone,
+					     struct list_head *list,
+					     enum lru_list lru,
+					     struct pagevec *pvec)
 {
 	unsigned long pgmoved = 0;
-	struct pagevec pvec;
+	unsigned int nr_relocks = 0;
 	struct page *page;
 
-	pagevec_init(&pvec, 1);
-
 	while (!list_empty(list)) {
 		page = lru_to_page(list);
 
@@ -1262,17 +1335,19 @@ static void move_active_pages_to_lru(struct zone *zone,
 		mem_cgroup_add_lru_list(page, lru);
 		pgmoved++;
 
-		if (!pagevec_add(&pvec, page) || list_empty(list)) {
+		if (!pagevec_add(pvec, page)) {
 			spin_unlock_irq(&zone->lru_lock);
 			if (buffer_heads_over_limit)
-				pagevec_strip(&pvec);
-			__pagevec_release(&pvec);
+				pagevec_strip(pvec);
+			__pagevec_release(pvec);
 			spin_lock_irq(&zone->lru_lock);
+			nr_relocks++;
 		}
 	}
 	__mod_zone_page_state(zone, NR_LRU_BASE + lru, pgmoved);
 	if (!is_active_lru(lru))
 		__count_vm_events(PGDEACTIVATE, pgmoved);
+	return nr_relocks;
 }
 
 static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
@@ -1285,9 +1360,15 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 	LIST_HEAD(l_active);
 	LIST_HEAD(l_inactive);
 	struct page *page;
+	struct pagevec pvec;
 	struct zone_reclaim_stat *reclaim_stat = get_reclaim_stat(zone, sc);
 	unsigned long nr_rotated = 0;
+	unsigned int nr_lock_holds = 2;
 
+	trace_mm_vmscan_lru_shrink_begin(zone_to_nid(zone), zone_idx(zone),
+					 priority, 1, file);
+
+	pagevec_init(&pvec, 1);
 	lru_add_drain();
 	spin_lock_irq(&zone->lru_lock);
 	nr_taken = sc->isolate_pages(nr_pages, &l_hold, &pgscanned, sc->order,
@@ -1355,12 +1436,19 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 	 */
 	reclaim_stat->recent_rotated[file] += nr_rotated;
 
-	move_active_pages_to_lru(zone, &l_active,
-						LRU_ACTIVE + file * LRU_FILE);
-	move_active_pages_to_lru(zone, &l_inactive,
-						LRU_BASE   + file * LRU_FILE);
+	nr_lock_holds += move_active_pages_to_lru(zone, &l_active,
+					LRU_ACTIVE + file * LRU_FILE, &pvec);
+	nr_lock_holds += move_active_pages_to_lru(zone, &l_inactive,
+					LRU_BASE   + file * LRU_FILE, &pvec);
 	__mod_zone_page_state(zone, NR_ISOLATED_ANON + file, -nr_taken);
 	spin_unlock_irq(&zone->lru_lock);
+
+	if (buffer_heads_over_limit)
+		pagevec_strip(&pvec);
+	pagevec_release(&pvec);
+
+	trace_mm_vmscan_lru_shrink_end(pgscanned, nr_taken, 0, nr_rotated,
+				       nr_lock_holds);
 }
 
 static int inactive_anon_is_low_global(struct zone *zone)
@@ -1706,6 +1794,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 	int priority;
 	unsigned long ret = 0;
 	unsigned long total_scanned = 0;
+	unsigned long slab_scanned;
 	struct reclaim_state *reclaim_state = current->reclaim_state;
 	unsigned long lru_pages = 0;
 	struct zoneref *z;
@@ -1739,7 +1828,22 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		 * over limit cgroups
 		 */
 		if (scanning_global_lru(sc)) {
-			shrink_slab(sc->nr_scanned, sc->gfp_mask, lru_pages);
+			/*
+			 * Calling the shrinkers costs the same however little
+			 * they have to do: let the pressure of light passes,
+			 * from this and earlier direct reclaims, build up until
+			 * there is a batch of it or reclaim is getting hard.
+			 */
+			slab_scanned = atomic_long_add_return(sc->nr_scanned,
+							&slab_scanned_pending);
+			if (slab_scanned >= SHRINK_SLAB_BATCH ||
+			    priority < DEF_PRIORITY - 2) {
+				slab_scanned = atomic_long_xchg(
+						&slab_scanned_pending, 0);
+				if (slab_scanned)
+					shrink_slab(slab_scanned, sc->gfp_mask,
+						    lru_pages);
+			}
 			if (reclaim_state) {
 				sc->nr_reclaimed += reclaim_state->reclaimed_slab;
 				reclaim_state->reclaimed_slab = 0;
@@ -1813,8 +1917,14 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 		.isolate_pages = isolate_pages_global,
 		.nodemask = nodemask,
 	};
+	unsigned long nr_reclaimed;
 
-	return do_try_to_free_pages(zonelist, &sc);
+	trace_mm_vmscan_direct_reclaim_begin(order, sc.may_writepage,
+					     gfp_mask);
+	nr_reclaimed = do_try_to_free_pages(zonelist, &sc);
+	trace_mm_vmscan_direct_reclaim_end(nr_reclaimed);
+
+	return nr_reclaimed;
 }
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR
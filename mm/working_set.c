@@ -0,0 +1,410 @@
+/*
+ * mm/working_set.c - per-process working set estimation
+ *
+ * Resident set size says how much memory a process holds, not how much of
+ * it the process actually uses.  For the processes userspace selects by
+ * writing 1 to /proc/<pid>/working_set, a deferrable work periodically
+ * walks the page tables, tests and clears the accessed bit of each mapped
+ * page, and counts the pages found young (active) or old (idle) since the
+ * previous pass, separately for anonymous, file and ashmem mappings.
+ *
+ * Each sampling interval scans at most pages_per_scan pages of each
+ * process, resuming where the previous one stopped, so a pass over a big
+ * process is spread over several intervals.  The time spent is reported
+ * per process and in total under /sys/kernel/mm/working_set.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/kobject.h>
+#include <linux/hugetlb.h>
+#include <linux/workqueue.h>
+#include <linux/seq_file.h>
+#include <linux/ashmem.h>
+#include <linux/working_set.h>
+
+#include <asm/tlbflush.h>
+
+enum wss_type {
+	WSS_ANON,
+	WSS_FILE,
+	WSS_ASHMEM,
+	NR_WSS_TYPES
+};
+
+static const char * const wss_type_names[NR_WSS_TYPES] = {
+	[WSS_ANON]	= "anon",
+	[WSS_FILE]	= "file",
+	[WSS_ASHMEM]	= "ashmem",
+};
+
+struct wss_counts {
+	unsigned long active[NR_WSS_TYPES];
+	unsigned long idle[NR_WSS_TYPES];
+};
+
+/**
+ * struct wss_target - working set sampling state of one mm
+ * @list: link into wss_targets
+ * @mm: the mm sampled, pinned by mm_count
+ * @cursor: the address the next scan resumes from
+ * @pass: counts of the pass in progress
+ * @last: counts of the last complete pass, as reported
+ * @passes: number of complete passes
+ * @pages_scanned: number of ptes visited
+ * @scan_ns: time spent scanning this mm
+ */
+struct wss_target {
+	struct list_head list;
+	struct mm_struct *mm;
+	unsigned long cursor;
+	struct wss_counts pass;
+	struct wss_counts last;
+	unsigned long passes;
+	unsigned long pages_scanned;
+	u64 scan_ns;
+};
+
+/* State of one call to wss_scan_target(), passed down the page walk */
+struct wss_walk {
+	struct wss_target *target;
+	struct vm_area_struct *vma;
+	enum wss_type type;
+	unsigned long budget;
+	unsigned long stop;
+};
+
+static LIST_HEAD(wss_targets);
+static DEFINE_MUTEX(wss_mutex);
+
+/* Milliseconds between sampling intervals */
+static unsigned int wss_interval_millisecs = 5000;
+
+/* Most pages scanned in each process per interval */
+static unsigned int wss_pages_per_scan = 4096;
+
+/* Totals over all processes, for the cost of the facility as a whole */
+static unsigned long wss_total_pages_scanned;
+static u64 wss_total_scan_ns;
+
+static struct delayed_work wss_scan_work;
+
+static enum wss_type wss_vma_type(struct vm_area_struct *vma)
+{
+	if (!vma->vm_file)
+		return WSS_ANON;
+	if (is_ashmem_file(vma->vm_file))
+		return WSS_ASHMEM;
+	return WSS_FILE;
+}
+
+static int wss_pte_range(pmd_t *pmd, unsigned long addr,
+			 unsigned long end, struct mm_walk *walk)
+{
+	struct wss_walk *ww = walk->private;
+	struct wss_counts *counts = &ww->target->pass;
+	struct vm_area_struct *vma = ww->vma;
+	pte_t *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+	unsigned long nr = 0;
+
+	if (!ww->budget) {
+		ww->stop = addr;
+		return 1;
+	}
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		nr++;
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		/*
+		 * Pass the reference on to PG_referenced, where reclaim's
+		 * page_referenced() will still find it.
+		 */
+		if (ptep_test_and_clear_young(vma, addr, pte)) {
+			SetPageReferenced(page);
+			counts->active[ww->type]++;
+		} else
+			counts->idle[ww->type]++;
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+
+	ww->target->pages_scanned += nr;
+	ww->budget -= min(ww->budget, nr);
+	cond_resched();
+	return 0;
+}
+
+/*
+ * Scan up to wss_pages_per_scan pages of @target's mm from its cursor.
+ * Returns 0 if the mm has exited and the target should be dropped.
+ */
+static int wss_scan_target(struct wss_target *target)
+{
+	struct mm_struct *mm = target->mm;
+	struct vm_area_struct *vma;
+	unsigned long budget = wss_pages_per_scan;
+	struct wss_walk ww = {
+		.target = target,
+		.budget = budget,
+	};
+	struct mm_walk walk = {
+		.pmd_entry = wss_pte_range,
+		.mm = mm,
+		.private = &ww,
+	};
+	ktime_t start;
+	u64 delta;
+
+	if (!atomic_inc_not_zero(&mm->mm_users))
+		return 0;
+
+	start = ktime_get();
+	down_read(&mm->mmap_sem);
+	for (vma = find_vma(mm, target->cursor); vma; vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		ww.vma = vma;
+		ww.type = wss_vma_type(vma);
+		if (walk_page_range(max(vma->vm_start, target->cursor),
+				    vma->vm_end, &walk))
+			break;
+	}
+	flush_tlb_mm(mm);
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+
+	if (vma) {
+		target->cursor = ww.stop;
+	} else {
+		target->last = target->pass;
+		memset(&target->pass, 0, sizeof(target->pass));
+		target->cursor = 0;
+		target->passes++;
+	}
+
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	target->scan_ns += delta;
+	wss_total_scan_ns += delta;
+	wss_total_pages_scanned += budget - ww.budget;
+	return 1;
+}
+
+static void wss_free_target(struct wss_target *target)
+{
+	list_del(&target->list);
+	mmdrop(target->mm);
+	kfree(target);
+}
+
+static void wss_scan_work_fn(struct work_struct *work)
+{
+	struct wss_target *target, *next;
+
+	mutex_lock(&wss_mutex);
+	list_for_each_entry_safe(target, next, &wss_targets, list) {
+		if (!wss_scan_target(target))
+			wss_free_target(target);
+	}
+	if (!list_empty(&wss_targets))
+		schedule_delayed_work(&wss_scan_work,
+				msecs_to_jiffies(wss_interval_millisecs));
+	mutex_unlock(&wss_mutex);
+}
+
+/* Called with wss_mutex held */
+static struct wss_target *wss_find_target(struct mm_struct *mm)
+{
+	struct wss_target *target;
+
+	list_for_each_entry(target, &wss_targets, list) {
+		if (target->mm == mm)
+			return target;
+	}
+	return NULL;
+}
+
+/**
+ * working_set_start - start sampling the working set of @mm
+ * @mm: the mm, pinned by the caller
+ */
+int working_set_start(struct mm_struct *mm)
+{
+	struct wss_target *target;
+	int err = 0;
+
+	mutex_lock(&wss_mutex);
+	if (wss_find_target(mm))
+		goto out;
+
+	target = kzalloc(sizeof(*target), GFP_KERNEL);
+	if (!target) {
+		err = -ENOMEM;
+		goto out;
+	}
+	atomic_inc(&mm->mm_count);
+	target->mm = mm;
+
+	if (list_empty(&wss_targets))
+		schedule_delayed_work(&wss_scan_work,
+				msecs_to_jiffies(wss_interval_millisecs));
+	list_add_tail(&target->list, &wss_targets);
+out:
+	mutex_unlock(&wss_mutex);
+	return err;
+}
+
+/**
+ * working_set_stop - stop sampling @mm and forget what was gathered
+ * @mm: the mm, pinned by the caller
+ */
+void working_set_stop(struct mm_struct *mm)
+{
+	struct wss_target *target;
+
+	mutex_lock(&wss_mutex);
+	target = wss_find_target(mm);
+	if (target)
+		wss_free_target(target);
+	mutex_unlock(&wss_mutex);
+}
+
+/**
+ * working_set_show - report the last complete sampling pass over @mm
+ * @m: seq_file to print into
+ * @mm: the mm, pinned by the caller
+ *
+ * Prints nothing if @mm is not being sampled.
+ */
+void working_set_show(struct seq_file *m, struct mm_struct *mm)
+{
+	struct wss_target *target;
+	int i;
+
+	mutex_lock(&wss_mutex);
+	target = wss_find_target(mm);
+	if (target) {
+		for (i = 0; i < NR_WSS_TYPES; i++) {
+			seq_printf(m, "%s_active %lu\n", wss_type_names[i],
+				   target->last.active[i]);
+			seq_printf(m, "%s_idle %lu\n", wss_type_names[i],
+				   target->last.idle[i]);
+		}
+		seq_printf(m, "passes %lu\n", target->passes);
+		seq_printf(m, "pages_scanned %lu\n", target->pages_scanned);
+		seq_printf(m, "scan_usecs %llu\n",
+			   (unsigned long long)div_u64(target->scan_ns,
+						       NSEC_PER_USEC));
+	}
+	mutex_unlock(&wss_mutex);
+}
+
+#ifdef CONFIG_SYSFS
+#define WSS_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define WSS_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t interval_millisecs_show(struct kobject *kobj,
+				       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", wss_interval_millisecs);
+}
+
+static ssize_t interval_millisecs_store(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &msecs);
+	if (err || !msecs || msecs > UINT_MAX)
+		return -EINVAL;
+
+	wss_interval_millisecs = msecs;
+
+	return count;
+}
+WSS_ATTR(interval_millisecs);
+
+static ssize_t pages_per_scan_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", wss_pages_per_scan);
+}
+
+static ssize_t pages_per_scan_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	unsigned long nr_pages;
+	int err;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || !nr_pages || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	wss_pages_per_scan = nr_pages;
+
+	return count;
+}
+WSS_ATTR(pages_per_scan);
+
+static ssize_t pages_scanned_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", wss_total_pages_scanned);
+}
+WSS_ATTR_RO(pages_scanned);
+
+static ssize_t scan_usecs_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%llu\n",
+		       (unsigned long long)div_u64(wss_total_scan_ns,
+						   NSEC_PER_USEC));
+}
+WSS_ATTR_RO(scan_usecs);
+
+static struct attribute *wss_attrs[] = {
+	&interval_millisecs_attr.attr,
+	&pages_per_scan_attr.attr,
+	&pages_scanned_attr.attr,
+	&scan_usecs_attr.attr,
+	NULL,
+};
+
+static struct attribute_group wss_attr_group = {
+	.attrs = wss_attrs,
+	.name = "working_set",
+};
+#endif /* CONFIG_SYSFS */
+
+static int __init working_set_init(void)
+{
+	INIT_DELAYED_WORK_DEFERRABLE(&wss_scan_work, wss_scan_work_fn);
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &wss_attr_group))
+		printk(KERN_ERR "working_set: register sysfs failed\n");
+#endif
+	return 0;
+}
+module_init(working_set_init)
@@ -53,7 +53,7 @@ static struct {
 static void dst_gc_task(struct work_struct *work);
 static void ___dst_free(struct dst_entry * dst);
 
-static DECLARE_DELAYED_WORK(dst_gc_work, dst_gc_task);
+static DECLARE_DEFERRED_WORK(dst_gc_work, dst_gc_task);
 
 static DEFINE_MUTEX(dst_gc_mutex);
 /*
@@ -288,6 +288,69 @@ void skb_add_rx_frag(struct sk_buff *skb, int i, struct page *page, int off,
 }
 EXPORT_SYMBOL(skb_add_rx_frag);
 
+/**
+ *	skb_frag_cache_alloc - carve a receive buffer out of a cached page
+ *	@fc: per-device (or per-ring) fragment cache
+ *	@size: bytes needed, at most PAGE_SIZE
+ *	@gfp_mask: allocation flags for a new page
+ *	@page: returns the page holding the buffer
+ *	@offset: returns the buffer offset within @page
+ *
+ *	Hand out consecutive cache-line aligned pieces of one page.  The
+ *	caller gets its own reference on @page, which is normally given to
+ *	an skb with skb_add_rx_frag().  Once the page is used up it is
+ *	reused from the start if every skb pointing into it has been freed,
+ *	otherwise it is left to its users and a new page is allocated.
+ *
+ *	Returns 0 on success or a negative errno.  The cache must be
+ *	serialised by the caller (typically by NAPI).
+ */
+int skb_frag_cache_alloc(struct skb_frag_cache *fc, unsigned int size,
+			 gfp_t gfp_mask, struct page **page,
+			 unsigned int *offset)
+{
+	size = ALIGN(size, SMP_CACHE_BYTES);
+	if (unlikely(size > PAGE_SIZE))
+		return -EINVAL;
+
+	if (fc->page && fc->offset + size > PAGE_SIZE) {
+		if (page_count(fc->page) == 1) {
+			fc->offset = 0;
+		} else {
+			put_page(fc->page);
+			fc->page = NULL;
+		}
+	}
+	if (!fc->page) {
+		fc->page = alloc_page(gfp_mask);
+		if (!fc->page)
+			return -ENOMEM;
+		fc->offset = 0;
+	}
+
+	get_page(fc->page);
+	*page = fc->page;
+	*offset = fc->offset;
+	fc->offset += size;
+	return 0;
+}
+EXPORT_SYMBOL(skb_frag_cache_alloc);
+
+/**
+ *	skb_frag_cache_drain - release the page held by a fragment cache
+ *	@fc: fragment cache
+ *
+ *	Buffers already handed out stay valid until their skbs are freed.
+ */
+void skb_frag_cache_drain(struct skb_frag_cache *fc)
+{
+	if (fc->page)
+		put_page(fc->page);
+	fc->page = NULL;
+	fc->offset = 0;
+}
+EXPORT_SYMBOL(skb_frag_cache_drain);
+
 /**
  *	dev_alloc_skb - allocate an skbuff for receiving
  *	@length: length to allocate
@@ -1528,9 +1591,11 @@ static int __skb_splice_bits(struct sk_buff *skb, unsigned int *offset,
  * the frag list, if such a thing exists. We'd probably need to recurse to
  * handle that cleanly.
  */
-int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
-		    struct pipe_inode_info *pipe, unsigned int tlen,
-		    unsigned int flags)
+static int __skb_splice_to_pipe(struct sk_buff *skb, struct sock *sk,
+				unsigned int offset,
+				struct pipe_inode_info *pipe,
+				unsigned int tlen, unsigned int flags,
+				int sock_locked)
 {
 	struct partial_page partial[PIPE_BUFFERS];
 	struct page *pages[PIPE_BUFFERS];
@@ -1542,7 +1607,6 @@ int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
 		.spd_release = sock_spd_release,
 	};
 	struct sk_buff *frag_iter;
-	struct sock *sk = skb->sk;
 
 	/*
 	 * __skb_splice_bits() only fails if the output has no room left,
@@ -1567,6 +1631,9 @@ done:
 	if (spd.nr_pages) {
 		int ret;
 
+		if (!sock_locked)
+			return splice_to_pipe(pipe, &spd);
+
 		/*
 		 * Drop the socket lock, otherwise we have reverse
 		 * locking dependencies between sk_lock and i_mutex
@@ -1585,6 +1652,26 @@ done:
 	return 0;
 }
 
+int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
+		    struct pipe_inode_info *pipe, unsigned int tlen,
+		    unsigned int flags)
+{
+	return __skb_splice_to_pipe(skb, skb->sk, offset, pipe, tlen, flags, 1);
+}
+
+/*
+ * As skb_splice_bits(), for a receiver that serialises readers with its
+ * own lock instead of the socket lock of skb->sk.  Linear data is copied
+ * through the sk_sndmsg_page of @sk.
+ */
+int skb_splice_bits_nolock(struct sk_buff *skb, struct sock *sk,
+			   unsigned int offset, struct pipe_inode_info *pipe,
+			   unsigned int tlen, unsigned int flags)
+{
+	return __skb_splice_to_pipe(skb, sk, offset, pipe, tlen, flags, 0);
+}
+EXPORT_SYMBOL_GPL(skb_splice_bits_nolock);
+
 /**
  *	skb_store_bits - store bits from kernel buffer to skb
  *	@skb: destination buffer
@@ -129,6 +129,7 @@
 #ifdef CONFIG_INET
 #include <net/tcp.h>
 #endif
+#include <net/uid_netstat.h>
 
 /*
  * Each address family might have different locking rules, so we have
@@ -295,6 +296,7 @@ int sock_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 		goto out;
 	}
 
+	uid_netstat_rx(sk, skb);
 	skb->dev = NULL;
 	skb_set_owner_r(skb, sk);
 
@@ -1134,6 +1136,7 @@ struct sock *sk_clone(const struct sock *sk, const gfp_t priority)
 				af_family_clock_key_strings[newsk->sk_family]);
 
 		newsk->sk_dst_cache	= NULL;
+		newsk->sk_rx_dst	= NULL;
 		newsk->sk_wmem_queued	= 0;
 		newsk->sk_forward_alloc = 0;
 		newsk->sk_send_head	= NULL;
@@ -1264,6 +1267,15 @@ void sock_rfree(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(sock_rfree);
 
+/*
+ * Drops the reference taken by early demux when the skb is freed
+ * before the protocol handler stole the socket.
+ */
+void sock_edemux(struct sk_buff *skb)
+{
+	sock_put(skb->sk);
+}
+
 
 int sock_i_uid(struct sock *sk)
 {
@@ -0,0 +1,304 @@
+/*
+ * net/core/uid_netstat.c - per-UID, per-interface traffic counters
+ *
+ * Bytes and packets of IPv4/IPv6 sockets, broken down by the UID owning
+ * the socket, the network device and the transport protocol.  Counting
+ * is done where locally generated packets enter the IP output path and
+ * where received packets are handed to a socket, so there is no
+ * per-packet rule traversal as with xt_owner matches.
+ *
+ * Every CPU keeps its own table, keyed on UID and interface index.
+ * Counters are only updated by the owning CPU with BHs off, under the
+ * per-CPU seqcount so that readers get consistent 64-bit values.  The
+ * chains are RCU-bh protected: entries are added by the owning CPU and
+ * removed when their interface is unregistered, both under the table's
+ * lock.  /proc/net/uid_stat sums all tables in one pass and looks up the
+ * interface names as it prints them.
+ *
+ * A packet still in flight when its interface goes away can leave a new
+ * entry behind for the dead index; such entries are not printed.
+ *
+ * This file is released under the GPLv2
+ */
+
+#include <linux/init.h>
+#include <linux/hash.h>
+#include <linux/netdevice.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/seqlock.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <net/net_namespace.h>
+#include <net/tcp_states.h>
+#include <net/uid_netstat.h>
+
+#define UID_NETSTAT_HASH_BITS	8
+#define UID_NETSTAT_HASH_SIZE	(1 << UID_NETSTAT_HASH_BITS)
+
+enum {
+	UID_NETSTAT_TCP,
+	UID_NETSTAT_UDP,
+	UID_NETSTAT_OTHER,
+	UID_NETSTAT_PROTOS
+};
+
+static const char *uid_netstat_proto_names[UID_NETSTAT_PROTOS] = {
+	"tcp", "udp", "other",
+};
+
+struct uid_netstat_counters {
+	u64	bytes[UID_NETSTAT_PROTOS][UID_NETSTAT_DIRS];
+	u64	packets[UID_NETSTAT_PROTOS][UID_NETSTAT_DIRS];
+};
+
+struct uid_netstat_entry {
+	struct hlist_node		node;
+	struct rcu_head			rcu;
+	uid_t				uid;
+	int				ifindex;
+	struct uid_netstat_counters	c;
+};
+
+struct uid_netstat_table {
+	spinlock_t		lock;	/* changes to the chains */
+	seqcount_t		seq;
+	struct hlist_head	hash[UID_NETSTAT_HASH_SIZE];
+};
+
+static DEFINE_PER_CPU(struct uid_netstat_table, uid_netstat_tables);
+
+static inline unsigned int uid_netstat_hash(uid_t uid, int ifindex)
+{
+	return hash_32(uid * 31 + ifindex, UID_NETSTAT_HASH_BITS);
+}
+
+static struct uid_netstat_entry *uid_netstat_find(struct hlist_head *head,
+						  uid_t uid, int ifindex)
+{
+	struct uid_netstat_entry *e;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(e, pos, head, node)
+		if (e->uid == uid && e->ifindex == ifindex)
+			return e;
+	return NULL;
+}
+
+void uid_netstat_account(struct sock *sk, const struct sk_buff *skb,
+			 int ifindex, int dir)
+{
+	struct uid_netstat_table *t;
+	struct uid_netstat_entry *e;
+	struct hlist_head *head;
+	unsigned int len, segs;
+	uid_t uid;
+	int proto;
+
+	/* interface indexes are only resolved in init_net */
+	if (!ifindex || sk->sk_state == TCP_TIME_WAIT ||
+	    (sk->sk_family != AF_INET && sk->sk_family != AF_INET6) ||
+	    !net_eq(sock_net(sk), &init_net))
+		return;
+
+	switch (sk->sk_protocol) {
+	case IPPROTO_TCP:
+		proto = UID_NETSTAT_TCP;
+		break;
+	case IPPROTO_UDP:
+		proto = UID_NETSTAT_UDP;
+		break;
+	default:
+		proto = UID_NETSTAT_OTHER;
+	}
+
+	/* from the network header, whatever the caller has pulled */
+	len = skb->len - skb_network_offset(skb);
+	segs = skb_is_gso(skb) ? skb_shinfo(skb)->gso_segs : 1;
+	uid = sock_i_uid(sk);
+
+	rcu_read_lock_bh();
+	t = &__get_cpu_var(uid_netstat_tables);
+	head = &t->hash[uid_netstat_hash(uid, ifindex)];
+
+	e = uid_netstat_find(head, uid, ifindex);
+	if (unlikely(e == NULL)) {
+		e = kzalloc(sizeof(*e), GFP_ATOMIC);
+		if (e == NULL)
+			goto out;
+		e->uid = uid;
+		e->ifindex = ifindex;
+		spin_lock(&t->lock);
+		hlist_add_head_rcu(&e->node, head);
+		spin_unlock(&t->lock);
+	}
+
+	write_seqcount_begin(&t->seq);
+	e->c.bytes[proto][dir] += len;
+	e->c.packets[proto][dir] += segs;
+	write_seqcount_end(&t->seq);
+out:
+	rcu_read_unlock_bh();
+}
+
+static void uid_netstat_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct uid_netstat_entry, rcu));
+}
+
+/* Drop the counters of an interface that is going away */
+static void uid_netstat_remove(int ifindex)
+{
+	struct uid_netstat_table *t;
+	struct uid_netstat_entry *e;
+	struct hlist_node *pos, *n;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		t = &per_cpu(uid_netstat_tables, cpu);
+		spin_lock_bh(&t->lock);
+		for (i = 0; i < UID_NETSTAT_HASH_SIZE; i++)
+			hlist_for_each_entry_safe(e, pos, n, &t->hash[i],
+						  node) {
+				if (e->ifindex != ifindex)
+					continue;
+				hlist_del_rcu(&e->node);
+				call_rcu_bh(&e->rcu, uid_netstat_free_rcu);
+			}
+		spin_unlock_bh(&t->lock);
+	}
+}
+
+static int uid_netstat_netdev_event(struct notifier_block *this,
+				    unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+
+	if (event == NETDEV_UNREGISTER && net_eq(dev_net(dev), &init_net))
+		uid_netstat_remove(dev->ifindex);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block uid_netstat_netdev_notifier = {
+	.notifier_call = uid_netstat_netdev_event,
+};
+
+static int uid_netstat_show(struct seq_file *m, void *v)
+{
+	struct hlist_head *sums;
+	struct uid_netstat_counters c;
+	struct uid_netstat_table *t;
+	struct uid_netstat_entry *e, *s;
+	struct hlist_node *pos, *n;
+	struct net_device *dev;
+	char ifname[IFNAMSIZ];
+	unsigned int seq;
+	int cpu, i, p, d;
+	int err = 0;
+
+	sums = kmalloc(sizeof(*sums) * UID_NETSTAT_HASH_SIZE, GFP_KERNEL);
+	if (sums == NULL)
+		return -ENOMEM;
+	for (i = 0; i < UID_NETSTAT_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&sums[i]);
+
+	/* an entry hashes to the same bucket in every table */
+	for_each_possible_cpu(cpu) {
+		t = &per_cpu(uid_netstat_tables, cpu);
+		rcu_read_lock_bh();
+		for (i = 0; i < UID_NETSTAT_HASH_SIZE; i++) {
+			hlist_for_each_entry_rcu(e, pos, &t->hash[i], node) {
+				do {
+					seq = read_seqcount_begin(&t->seq);
+					c = e->c;
+				} while (read_seqcount_retry(&t->seq, seq));
+
+				s = uid_netstat_find(&sums[i], e->uid,
+						     e->ifindex);
+				if (s == NULL) {
+					s = kzalloc(sizeof(*s), GFP_ATOMIC);
+					if (s == NULL) {
+						err = -ENOMEM;
+						rcu_read_unlock_bh();
+						goto out;
+					}
+					s->uid = e->uid;
+					s->ifindex = e->ifindex;
+					hlist_add_head(&s->node, &sums[i]);
+				}
+				for (p = 0; p < UID_NETSTAT_PROTOS; p++)
+					for (d = 0; d < UID_NETSTAT_DIRS; d++) {
+						s->c.bytes[p][d] +=
+							c.bytes[p][d];
+						s->c.packets[p][d] +=
+							c.packets[p][d];
+					}
+			}
+		}
+		rcu_read_unlock_bh();
+	}
+out:
+	if (!err) {
+		seq_puts(m, "uid iface");
+		for (p = 0; p < UID_NETSTAT_PROTOS; p++)
+			seq_printf(m, " %s_rx_bytes %s_rx_packets"
+				   " %s_tx_bytes %s_tx_packets",
+				   uid_netstat_proto_names[p],
+				   uid_netstat_proto_names[p],
+				   uid_netstat_proto_names[p],
+				   uid_netstat_proto_names[p]);
+		seq_putc(m, '\n');
+	}
+
+	for (i = 0; i < UID_NETSTAT_HASH_SIZE; i++) {
+		hlist_for_each_entry_safe(s, pos, n, &sums[i], node) {
+			dev = err ? NULL : dev_get_by_index(&init_net,
+							    s->ifindex);
+			if (dev) {
+				strlcpy(ifname, dev->name, IFNAMSIZ);
+				dev_put(dev);
+				seq_printf(m, "%u %s", s->uid, ifname);
+				for (p = 0; p < UID_NETSTAT_PROTOS; p++)
+					for (d = 0; d < UID_NETSTAT_DIRS; d++)
+						seq_printf(m, " %llu %llu",
+						(unsigned long long)
+							s->c.bytes[p][d],
+						(unsigned long long)
+							s->c.packets[p][d]);
+				seq_putc(m, '\n');
+			}
+			kfree(s);
+		}
+	}
+	kfree(sums);
+	return err;
+}
+
+static int uid_netstat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uid_netstat_show, NULL);
+}
+
+static const struct file_operations uid_netstat_fops = {
+	.owner		= THIS_MODULE,
+	.open		= uid_netstat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init uid_netstat_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu(uid_netstat_tables, cpu).lock);
+	if (!proc_net_fops_create(&init_net, "uid_stat", S_IRUGO,
+				  &uid_netstat_fops))
+		return -ENOMEM;
+	register_netdevice_notifier(&uid_netstat_netdev_notifier);
+	return 0;
+}
+
+__initcall(uid_netstat_init);
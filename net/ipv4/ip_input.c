@@ -144,6 +144,8 @@
 #include <linux/mroute.h>
 #include <linux/netlink.h>
 
+int sysctl_ip_early_demux __read_mostly = 1;
+
 /*
  *	Process Router Attention IP option
  */
@@ -320,11 +322,46 @@ drop:
 	return -1;
 }
 
-static int ip_rcv_finish(struct sk_buff *skb)
+/*
+ *	Let the transport protocol find the socket of an unfragmented
+ *	packet before routing.  A connected socket hands us the input
+ *	route it cached from an earlier packet of the same flow, which
+ *	saves the route cache and fib lookups below.
+ */
+static void ip_early_demux(struct sk_buff *skb)
 {
+	const struct net_protocol *ipprot;
 	const struct iphdr *iph = ip_hdr(skb);
+
+	if (iph->ihl > 5 || (iph->frag_off & htons(IP_MF | IP_OFFSET)))
+		return;
+
+	rcu_read_lock();
+	ipprot = rcu_dereference(inet_protos[iph->protocol &
+					     (MAX_INET_PROTOS - 1)]);
+	if (ipprot && ipprot->early_demux) {
+		ipprot->early_demux(skb);
+		if (skb_dst(skb))
+			NET_INC_STATS_BH(dev_net(skb->dev),
+					 LINUX_MIB_IPEARLYDEMUXHIT);
+		else
+			NET_INC_STATS_BH(dev_net(skb->dev),
+					 LINUX_MIB_IPEARLYDEMUXMISS);
+	}
+	rcu_read_unlock();
+}
+
+static int ip_rcv_finish(struct sk_buff *skb)
+{
+	const struct iphdr *iph;
 	struct rtable *rt;
 
+	if (sysctl_ip_early_demux && skb_dst(skb) == NULL && skb->sk == NULL)
+		ip_early_demux(skb);
+
+	/* early demux may have pulled, skb->head might have changed */
+	iph = ip_hdr(skb);
+
 	/*
 	 *	Initialise the virtual path cache for the packet. It describes
 	 *	how the packet travels inside Linux networking.
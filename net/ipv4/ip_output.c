@@ -73,6 +73,7 @@
 #include <net/icmp.h>
 #include <net/checksum.h>
 #include <net/inetpeer.h>
+#include <net/uid_netstat.h>
 #include <linux/igmp.h>
 #include <linux/netfilter_ipv4.h>
 #include <linux/netfilter_bridge.h>
@@ -104,8 +105,10 @@ int ip_local_out(struct sk_buff *skb)
 	int err;
 
 	err = __ip_local_out(skb);
-	if (likely(err == 1))
+	if (likely(err == 1)) {
+		uid_netstat_tx(skb);
 		err = dst_output(skb);
+	}
 
 	return err;
 }
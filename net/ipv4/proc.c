@@ -249,6 +249,11 @@ static const struct snmp_mib snmp4_net_list[] = {
 	SNMP_MIB_ITEM("TCPSackShifted", LINUX_MIB_SACKSHIFTED),
 	SNMP_MIB_ITEM("TCPSackMerged", LINUX_MIB_SACKMERGED),
 	SNMP_MIB_ITEM("TCPSackShiftFallback", LINUX_MIB_SACKSHIFTFALLBACK),
+	SNMP_MIB_ITEM("TCPRcvCoalesce", LINUX_MIB_TCPRCVCOALESCE),
+	SNMP_MIB_ITEM("TCPRcvCoalesceSaved", LINUX_MIB_TCPRCVCOALESCESAVED),
+	SNMP_MIB_ITEM("TCPRcvCollapseAvoided", LINUX_MIB_TCPRCVCOLLAPSEAVOIDED),
+	SNMP_MIB_ITEM("IPEarlyDemuxHit", LINUX_MIB_IPEARLYDEMUXHIT),
+	SNMP_MIB_ITEM("IPEarlyDemuxMiss", LINUX_MIB_IPEARLYDEMUXMISS),
 	SNMP_MIB_SENTINEL
 };
 
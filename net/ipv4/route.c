@@ -711,6 +711,51 @@ static inline int rt_is_expired(struct rtable *rth)
 	return rth->rt_genid != rt_genid(dev_net(rth->u.dst.dev));
 }
 
+/*
+ * Early demux: a connected socket keeps the input route of the last
+ * packet it accepted in sk->sk_rx_dst.  It is only changed with the
+ * socket locked and not owned by user, so ip_sk_rx_dst_attach() reads
+ * it under bh_lock_sock().  The reference held by the socket keeps the
+ * entry alive; a flush or a generation bump makes it fail the check
+ * below and the packet takes the slow path again.
+ */
+static inline int ip_rx_dst_valid(struct rtable *rt, const struct iphdr *iph,
+				  int iif)
+{
+	return rt->fl.fl4_src == iph->saddr && rt->fl.fl4_dst == iph->daddr &&
+	       rt->fl.iif == iif && !rt->u.dst.obsolete && !rt_is_expired(rt);
+}
+
+void ip_sk_rx_dst_set(struct sock *sk, struct sk_buff *skb)
+{
+	struct rtable *rt = skb_rtable(skb);
+	struct dst_entry *old = sk->sk_rx_dst;
+
+	if (!rt || &rt->u.dst == old)
+		return;
+	if (rt->rt_type != RTN_LOCAL || !rt->fl.iif)
+		return;
+
+	dst_hold(&rt->u.dst);
+	sk->sk_rx_dst = &rt->u.dst;
+	dst_release(old);
+}
+
+void ip_sk_rx_dst_attach(struct sock *sk, struct sk_buff *skb)
+{
+	struct dst_entry *dst;
+
+	bh_lock_sock(sk);
+	dst = sk->sk_rx_dst;
+	if (dst && !sock_owned_by_user(sk) &&
+	    ip_rx_dst_valid((struct rtable *)dst, ip_hdr(skb),
+			    skb->dev->ifindex)) {
+		dst_hold(dst);
+		skb_dst_set(skb, dst);
+	}
+	bh_unlock_sock(sk);
+}
+
 /*
  * Perform a full scan of hash table and free all entries.
  * Can be called by a softirq or a process.
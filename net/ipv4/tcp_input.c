@@ -91,6 +91,7 @@ int sysctl_tcp_nometrics_save __read_mostly;
 
 int sysctl_tcp_moderate_rcvbuf __read_mostly = 1;
 int sysctl_tcp_abc __read_mostly;
+int sysctl_tcp_rcv_coalesce __read_mostly = 1;
 
 #define FLAG_DATA		0x01 /* Incoming frame contained data.		*/
 #define FLAG_WIN_UPDATE		0x02 /* Incoming ACK was a window update.	*/
@@ -4287,11 +4288,81 @@ static inline int tcp_try_rmem_schedule(struct sock *sk, unsigned int size)
 	return 0;
 }
 
+/* Try to append the payload of an in-sequence segment, whose TCP header
+ * has already been pulled, to the last skb on the receive queue.  A run
+ * of small segments then costs one sk_buff (and one truesize) instead
+ * of one each, which keeps us under sk_rcvbuf and away from
+ * tcp_prune_queue()/tcp_collapse() on memory constrained devices.
+ *
+ * Small payloads are copied into the tailroom of a linear tail skb;
+ * payloads that live entirely in page fragments have their pages
+ * shared with the tail skb.  @from itself is left intact, so that the
+ * caller may still look at it, and must be freed by the caller when
+ * this returns nonzero.  Its memory was never charged to the socket.
+ */
+static int tcp_try_coalesce(struct sock *sk, struct sk_buff *from)
+{
+	struct sk_buff *to = skb_peek_tail(&sk->sk_receive_queue);
+	int len = from->len;
+	int delta, saved, i;
+
+	if (!sysctl_tcp_rcv_coalesce || !to || !len)
+		return 0;
+
+	/* tcp_recvmsg() needs SYN and FIN on a segment boundary */
+	if (tcp_hdr(to)->syn || tcp_hdr(to)->fin ||
+	    tcp_hdr(from)->syn || tcp_hdr(from)->fin)
+		return 0;
+
+	if (TCP_SKB_CB(to)->end_seq != TCP_SKB_CB(from)->seq ||
+	    skb_cloned(to))
+		return 0;
+
+	if (!skb_is_nonlinear(to) && len <= skb_tailroom(to)) {
+		BUG_ON(skb_copy_bits(from, 0, skb_put(to, len), len));
+		delta = 0;
+	} else if (!skb_headlen(from) && !skb_has_frags(from) &&
+		   !skb_has_frags(to) &&
+		   skb_shinfo(to)->nr_frags + skb_shinfo(from)->nr_frags <=
+		   MAX_SKB_FRAGS) {
+		for (i = 0; i < skb_shinfo(from)->nr_frags; i++) {
+			skb_frag_t *frag = &skb_shinfo(from)->frags[i];
+
+			get_page(frag->page);
+			skb_shinfo(to)->frags[skb_shinfo(to)->nr_frags++] =
+				*frag;
+		}
+		to->len += len;
+		to->data_len += len;
+		/* charge the pages taken over, not just the payload in them */
+		delta = from->truesize - sizeof(struct sk_buff) -
+			(skb_end_pointer(from) - from->head);
+		delta = max(delta, len);
+	} else
+		return 0;
+
+	if (delta) {
+		to->truesize += delta;
+		atomic_add(delta, &sk->sk_rmem_alloc);
+		sk_mem_charge(sk, delta);
+	}
+	TCP_SKB_CB(to)->end_seq = TCP_SKB_CB(from)->end_seq;
+
+	saved = from->truesize - delta;
+	NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPRCVCOALESCE);
+	NET_ADD_STATS_BH(sock_net(sk), LINUX_MIB_TCPRCVCOALESCESAVED, saved);
+	if (atomic_read(&sk->sk_rmem_alloc) <= sk->sk_rcvbuf &&
+	    atomic_read(&sk->sk_rmem_alloc) + saved > sk->sk_rcvbuf)
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPRCVCOLLAPSEAVOIDED);
+	return 1;
+}
+
 static void tcp_data_queue(struct sock *sk, struct sk_buff *skb)
 {
 	struct tcphdr *th = tcp_hdr(skb);
 	struct tcp_sock *tp = tcp_sk(sk);
 	int eaten = -1;
+	int coalesced = 0;
 
 	if (TCP_SKB_CB(skb)->seq == TCP_SKB_CB(skb)->end_seq)
 		goto drop;
@@ -4335,8 +4406,11 @@ queue_and_out:
 			    tcp_try_rmem_schedule(sk, skb->truesize))
 				goto drop;
 
-			skb_set_owner_r(skb, sk);
-			__skb_queue_tail(&sk->sk_receive_queue, skb);
+			coalesced = tcp_try_coalesce(sk, skb);
+			if (!coalesced) {
+				skb_set_owner_r(skb, sk);
+				__skb_queue_tail(&sk->sk_receive_queue, skb);
+			}
 		}
 		tp->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
 		if (skb->len)
@@ -4359,9 +4433,9 @@ queue_and_out:
 
 		tcp_fast_path_check(sk);
 
-		if (eaten > 0)
+		if (eaten > 0 || coalesced)
 			__kfree_skb(skb);
-		else if (!sock_flag(sk, SOCK_DEAD))
+		if (eaten <= 0 && !sock_flag(sk, SOCK_DEAD))
 			sk->sk_data_ready(sk, 0);
 		return;
 	}
@@ -5232,6 +5306,7 @@ int tcp_rcv_established(struct sock *sk, struct sk_buff *skb,
 			}
 		} else {
 			int eaten = 0;
+			int coalesced = 0;
 			int copied_early = 0;
 
 			if (tp->copied_seq == tp->rcv_nxt &&
@@ -5291,8 +5366,11 @@ int tcp_rcv_established(struct sock *sk, struct sk_buff *skb,
 
 				/* Bulk data transfer: receiver */
 				__skb_pull(skb, tcp_header_len);
-				__skb_queue_tail(&sk->sk_receive_queue, skb);
-				skb_set_owner_r(skb, sk);
+				coalesced = tcp_try_coalesce(sk, skb);
+				if (!coalesced) {
+					__skb_queue_tail(&sk->sk_receive_queue, skb);
+					skb_set_owner_r(skb, sk);
+				}
 				tp->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
 			}
 
@@ -5316,8 +5394,11 @@ no_ack:
 #endif
 			if (eaten)
 				__kfree_skb(skb);
-			else
+			else {
+				if (coalesced)
+					__kfree_skb(skb);
 				sk->sk_data_ready(sk, 0);
+			}
 			return 0;
 		}
 	}
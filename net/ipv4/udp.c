@@ -1060,6 +1060,9 @@ static int __udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 	int is_udplite = IS_UDPLITE(sk);
 	int rc;
 
+	if (sk->sk_state == TCP_ESTABLISHED)
+		ip_sk_rx_dst_set(sk, skb);
+
 	if ((rc = sock_queue_rcv_skb(sk, skb)) < 0) {
 		/* Note that an ENOMEM error is charged twice */
 		if (rc == -ENOMEM) {
@@ -1373,6 +1376,43 @@ drop:
 	return 0;
 }
 
+/*
+ *	Early demux for connected sockets, called from ip_rcv_finish()
+ *	before routing.  The socket is only attached to the skb together
+ *	with its cached input route, so that broadcasts still reach
+ *	__udp4_lib_mcast_deliver() through the slow path.
+ */
+void udp_v4_early_demux(struct sk_buff *skb)
+{
+	const struct iphdr *iph;
+	const struct udphdr *uh;
+	struct sock *sk;
+
+	if (skb->pkt_type != PACKET_HOST)
+		return;
+
+	if (!pskb_may_pull(skb, ip_hdrlen(skb) + sizeof(struct udphdr)))
+		return;
+
+	iph = ip_hdr(skb);
+	uh = (struct udphdr *)((char *)iph + ip_hdrlen(skb));
+	sk = __udp4_lib_lookup(dev_net(skb->dev), iph->saddr, uh->source,
+			       iph->daddr, uh->dest, skb->dev->ifindex,
+			       &udp_table);
+	if (!sk)
+		return;
+
+	if (sk->sk_state == TCP_ESTABLISHED) {
+		ip_sk_rx_dst_attach(sk, skb);
+		if (skb_dst(skb)) {
+			skb->sk = sk;
+			skb->destructor = sock_edemux;
+			return;
+		}
+	}
+	sock_put(sk);
+}
+
 int udp_rcv(struct sk_buff *skb)
 {
 	return __udp4_lib_rcv(skb, &udp_table, IPPROTO_UDP);
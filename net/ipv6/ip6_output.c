@@ -53,6 +53,7 @@
 #include <net/icmp.h>
 #include <net/xfrm.h>
 #include <net/checksum.h>
+#include <net/uid_netstat.h>
 #include <linux/mroute6.h>
 
 static int ip6_fragment(struct sk_buff *skb, int (*output)(struct sk_buff *));
@@ -75,8 +76,10 @@ int ip6_local_out(struct sk_buff *skb)
 	int err;
 
 	err = __ip6_local_out(skb);
-	if (likely(err == 1))
+	if (likely(err == 1)) {
+		uid_netstat_tx(skb);
 		err = dst_output(skb);
+	}
 
 	return err;
 }
@@ -261,8 +264,7 @@ int ip6_xmit(struct sock *sk, struct sk_buff *skb, struct flowi *fl,
 	if ((skb->len <= mtu) || skb->local_df || skb_is_gso(skb)) {
 		IP6_UPD_PO_STATS(net, ip6_dst_idev(skb_dst(skb)),
 			      IPSTATS_MIB_OUT, skb->len);
-		return NF_HOOK(PF_INET6, NF_INET_LOCAL_OUT, skb, NULL, dst->dev,
-				dst_output);
+		return ip6_local_out(skb);
 	}
 
 	if (net_ratelimit())
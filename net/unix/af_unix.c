@@ -114,6 +114,7 @@
 #include <linux/mount.h>
 #include <net/checksum.h>
 #include <linux/security.h>
+#include <linux/splice.h>
 
 static struct hlist_head unix_socket_table[UNIX_HASH_SIZE + 1];
 static DEFINE_SPINLOCK(unix_table_lock);
@@ -360,6 +361,12 @@ static void unix_sock_destructor(struct sock *sk)
 	if (u->addr)
 		unix_release_addr(u->addr);
 
+	/* page used to copy linear data out by splice */
+	if (sk->sk_sndmsg_page) {
+		put_page(sk->sk_sndmsg_page);
+		sk->sk_sndmsg_page = NULL;
+	}
+
 	atomic_dec(&unix_nr_socks);
 	local_bh_disable();
 	sock_prot_inuse_add(sock_net(sk), sk->sk_prot, -1);
@@ -495,6 +502,11 @@ static int unix_stream_sendmsg(struct kiocb *, struct socket *,
 			       struct msghdr *, size_t);
 static int unix_stream_recvmsg(struct kiocb *, struct socket *,
 			       struct msghdr *, size_t, int);
+static ssize_t unix_stream_sendpage(struct socket *, struct page *, int,
+				    size_t, int);
+static ssize_t unix_stream_splice_read(struct socket *, loff_t *,
+				       struct pipe_inode_info *, size_t,
+				       unsigned int);
 static int unix_dgram_sendmsg(struct kiocb *, struct socket *,
 			      struct msghdr *, size_t);
 static int unix_dgram_recvmsg(struct kiocb *, struct socket *,
@@ -522,7 +534,8 @@ static const struct proto_ops unix_stream_ops = {
 	.sendmsg =	unix_stream_sendmsg,
 	.recvmsg =	unix_stream_recvmsg,
 	.mmap =		sock_no_mmap,
-	.sendpage =	sock_no_sendpage,
+	.sendpage =	unix_stream_sendpage,
+	.splice_read =	unix_stream_splice_read,
 };
 
 static const struct proto_ops unix_dgram_ops = {
@@ -1491,6 +1504,34 @@ out:
 	return err;
 }
 
+/*
+ * Small stream writes are allocated with UNIX_STREAM_COALESCE bytes of
+ * room, and later small writes are copied into that room while the skb
+ * is still the last one on the peer's queue.  A burst of short messages
+ * then costs the reader one skb instead of one per write.
+ */
+#define UNIX_STREAM_COALESCE	512
+
+static inline unsigned int unix_skb_len(const struct sk_buff *skb)
+{
+	return skb->len - UNIXCB(skb).consumed;
+}
+
+/*
+ * The last skb queued to other, if data sent by sk with these credentials
+ * may be appended to it.  Must be called under unix_state_lock(other):
+ * readers take an skb off the queue under that lock before touching it.
+ */
+static struct sk_buff *unix_stream_tail(struct sock *sk, struct sock *other,
+					struct ucred *creds)
+{
+	struct sk_buff *tail = skb_peek_tail(&other->sk_receive_queue);
+
+	if (tail == NULL || tail->sk != sk || UNIXCB(tail).fp ||
+	    memcmp(UNIXCREDS(tail), creds, sizeof(*creds)) != 0)
+		return NULL;
+	return tail;
+}
 
 static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 			       struct msghdr *msg, size_t len)
@@ -1500,7 +1541,7 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	struct sock *other = NULL;
 	struct sockaddr_un *sunaddr = msg->msg_name;
 	int err, size;
-	struct sk_buff *skb;
+	struct sk_buff *skb, *tail;
 	int sent = 0;
 	struct scm_cookie tmp_scm;
 	bool fds_sent = false;
@@ -1549,8 +1590,8 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		 *	Grab a buffer
 		 */
 
-		skb = sock_alloc_send_skb(sk, size, msg->msg_flags&MSG_DONTWAIT,
-					  &err);
+		skb = sock_alloc_send_skb(sk, max(size, UNIX_STREAM_COALESCE),
+					  msg->msg_flags&MSG_DONTWAIT, &err);
 
 		if (skb == NULL)
 			goto out_err;
@@ -1587,8 +1628,18 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		    (other->sk_shutdown & RCV_SHUTDOWN))
 			goto pipe_err_free;
 
-		skb_queue_tail(&other->sk_receive_queue, skb);
-		unix_state_unlock(other);
+		tail = NULL;
+		if (size < UNIX_STREAM_COALESCE && !UNIXCB(skb).fp)
+			tail = unix_stream_tail(sk, other, UNIXCREDS(skb));
+		if (tail && !skb_is_nonlinear(tail) &&
+		    skb_tailroom(tail) >= size) {
+			memcpy(skb_put(tail, size), skb->data, size);
+			unix_state_unlock(other);
+			consume_skb(skb);
+		} else {
+			skb_queue_tail(&other->sk_receive_queue, skb);
+			unix_state_unlock(other);
+		}
 		other->sk_data_ready(other, size);
 		sent += size;
 	}
@@ -1611,6 +1662,91 @@ out_err:
 	return sent ? : err;
 }
 
+/*
+ * Queue a reference to the page instead of copying it; this is what
+ * splice() and sendfile() to a unix stream socket end up calling.
+ */
+static ssize_t unix_stream_sendpage(struct socket *sock, struct page *page,
+				    int offset, size_t size, int flags)
+{
+	struct sock *sk = sock->sk;
+	struct sock *other;
+	struct sk_buff *skb, *tail;
+	struct scm_cookie scm;
+	struct msghdr msg = { .msg_flags = flags };
+	int err, i;
+
+	if (flags & MSG_OOB)
+		return -EOPNOTSUPP;
+
+	other = unix_peer(sk);
+	if (!other || sk->sk_state != TCP_ESTABLISHED)
+		return -ENOTCONN;
+
+	err = scm_send(sock, &msg, &scm);
+	if (err < 0)
+		return err;
+
+	if (sk->sk_shutdown & SEND_SHUTDOWN)
+		goto pipe_err;
+
+	/* an empty skb, so that we block on sk_sndbuf like sendmsg() */
+	skb = sock_alloc_send_skb(sk, 0, flags & MSG_DONTWAIT, &err);
+	if (skb == NULL)
+		goto out;
+	memcpy(UNIXCREDS(skb), &scm.creds, sizeof(struct ucred));
+
+	unix_state_lock(other);
+
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN)) {
+		unix_state_unlock(other);
+		kfree_skb(skb);
+		goto pipe_err;
+	}
+
+	tail = unix_stream_tail(sk, other, &scm.creds);
+	if (tail) {
+		i = skb_shinfo(tail)->nr_frags;
+		if (skb_can_coalesce(tail, i, page, offset)) {
+			skb_shinfo(tail)->frags[i - 1].size += size;
+		} else if (i < MAX_SKB_FRAGS) {
+			get_page(page);
+			skb_fill_page_desc(tail, i, page, offset, size);
+		} else
+			tail = NULL;
+	}
+
+	if (tail) {
+		tail->len += size;
+		tail->data_len += size;
+		tail->truesize += size;
+		atomic_add(size, &sk->sk_wmem_alloc);
+		unix_state_unlock(other);
+		consume_skb(skb);
+	} else {
+		get_page(page);
+		skb_fill_page_desc(skb, 0, page, offset, size);
+		skb->len += size;
+		skb->data_len += size;
+		skb->truesize += size;
+		atomic_add(size, &sk->sk_wmem_alloc);
+		skb_queue_tail(&other->sk_receive_queue, skb);
+		unix_state_unlock(other);
+	}
+	other->sk_data_ready(other, size);
+	scm_destroy(&scm);
+	return size;
+
+pipe_err:
+	if (!(flags & MSG_NOSIGNAL))
+		send_sig(SIGPIPE, current, 0);
+	err = -EPIPE;
+out:
+	scm_destroy(&scm);
+	return err;
+}
+
 static int unix_seqpacket_sendmsg(struct kiocb *kiocb, struct socket *sock,
 				  struct msghdr *msg, size_t len)
 {
@@ -1856,8 +1992,9 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 			sunaddr = NULL;
 		}
 
-		chunk = min_t(unsigned int, skb->len, size);
-		if (memcpy_toiovec(msg->msg_iov, skb->data, chunk)) {
+		chunk = min_t(unsigned int, unix_skb_len(skb), size);
+		if (skb_copy_datagram_iovec(skb, UNIXCB(skb).consumed,
+					    msg->msg_iov, chunk)) {
 			skb_queue_head(&sk->sk_receive_queue, skb);
 			if (copied == 0)
 				copied = -EFAULT;
@@ -1868,13 +2005,13 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 
 		/* Mark read part of skb as used */
 		if (!(flags & MSG_PEEK)) {
-			skb_pull(skb, chunk);
+			UNIXCB(skb).consumed += chunk;
 
 			if (UNIXCB(skb).fp)
 				unix_detach_fds(siocb->scm, skb);
 
 			/* put the skb back if we didn't use it up.. */
-			if (skb->len) {
+			if (unix_skb_len(skb)) {
 				skb_queue_head(&sk->sk_receive_queue, skb);
 				break;
 			}
@@ -1901,6 +2038,89 @@ out:
 	return copied ? : err;
 }
 
+static ssize_t unix_stream_splice_read(struct socket *sock, loff_t *ppos,
+				       struct pipe_inode_info *pipe,
+				       size_t len, unsigned int flags)
+{
+	struct sock *sk = sock->sk;
+	struct unix_sock *u = unix_sk(sk);
+	struct scm_cookie scm;
+	struct sk_buff *skb;
+	ssize_t spliced = 0;
+	int err = 0;
+	long timeo;
+
+	if (sk->sk_state != TCP_ESTABLISHED)
+		return -EINVAL;
+
+	timeo = sock_rcvtimeo(sk, (sock->file->f_flags & O_NONBLOCK) ||
+				  (flags & SPLICE_F_NONBLOCK));
+
+	mutex_lock(&u->readlock);
+
+	while (len) {
+		unix_state_lock(sk);
+		skb = skb_dequeue(&sk->sk_receive_queue);
+		if (skb == NULL) {
+			if (spliced)
+				goto unlock;
+
+			err = sock_error(sk);
+			if (err)
+				goto unlock;
+			if (sk->sk_shutdown & RCV_SHUTDOWN)
+				goto unlock;
+
+			unix_state_unlock(sk);
+			err = -EAGAIN;
+			if (!timeo)
+				break;
+			mutex_unlock(&u->readlock);
+
+			timeo = unix_stream_data_wait(sk, timeo);
+
+			if (signal_pending(current)) {
+				err = sock_intr_errno(timeo);
+				goto out;
+			}
+			mutex_lock(&u->readlock);
+			continue;
+ unlock:
+			unix_state_unlock(sk);
+			break;
+		}
+		unix_state_unlock(sk);
+
+		/* Descriptors cannot be passed through a pipe; drop them */
+		if (UNIXCB(skb).fp) {
+			unix_detach_fds(&scm, skb);
+			scm_destroy(&scm);
+		}
+
+		err = skb_splice_bits_nolock(skb, sk, UNIXCB(skb).consumed, pipe,
+					     min_t(size_t, unix_skb_len(skb), len),
+					     flags);
+		if (err <= 0) {
+			skb_queue_head(&sk->sk_receive_queue, skb);
+			break;
+		}
+		spliced += err;
+		len -= err;
+
+		UNIXCB(skb).consumed += err;
+		if (unix_skb_len(skb)) {
+			/* put the skb back if we didn't use it up.. */
+			skb_queue_head(&sk->sk_receive_queue, skb);
+			break;
+		}
+		kfree_skb(skb);
+	}
+
+	mutex_unlock(&u->readlock);
+out:
+	return spliced ? : err;
+}
+
 static int unix_shutdown(struct socket *sock, int mode)
 {
 	struct sock *sk = sock->sk;
@@ -1967,7 +2187,7 @@ static int unix_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 			if (sk->sk_type == SOCK_STREAM ||
 			    sk->sk_type == SOCK_SEQPACKET) {
 				skb_queue_walk(&sk->sk_receive_queue, skb)
-					amount += skb->len;
+					amount += unix_skb_len(skb);
 			} else {
 				skb = skb_peek(&sk->sk_receive_queue);
 				if (skb)